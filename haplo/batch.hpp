@@ -0,0 +1,345 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   batch.hpp
+/// @brief  Header file for the batch runner, which phases many input files concurrently in one process
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_BATCH_HPP
+#define PARAHAPLO_BATCH_HPP
+
+#include "driver.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <tbb/tbb.h>
+#include <tbb/flow_graph.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <glob.h>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#ifndef BATCH_JOBS
+    #define BATCH_JOBS              4           // Input files phased at the same time (default)
+#endif
+#ifndef BATCH_BYTES_PER_INPUT
+    #define BATCH_BYTES_PER_INPUT   16          // Bytes of read and snp information per byte of input
+#endif
+
+namespace haplo {
+
+namespace io = boost::iostreams;
+
+namespace job {
+
+static constexpr uint8_t solved     = 0;        // The file was phased
+static constexpr uint8_t skipped    = 1;        // The file would exceed the memory cap or the block size
+static constexpr uint8_t failed     = 2;        // The file could not be read or phased
+
+static constexpr const char* names[3] = { "solved", "skipped", "failed" };
+
+}               // End namespace job
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     BatchResult
+/// @brief      The result of phasing a single input file of a batch
+// ----------------------------------------------------------------------------------------------------------
+struct BatchResult {
+    std::string     input;                  //!< The input file
+    std::string     output;                 //!< The file the haplotypes were written to
+    std::string     message;                //!< Why the file was skipped or failed (empty if solved)
+    uint8_t         status      = job::failed;  //!< If the file was phased (see job::)
+    size_t          reads       = 0;        //!< The number of reads in the file
+    size_t          snps        = 0;        //!< The number of snps in the file
+    size_t          subblocks   = 0;        //!< The number of sub-blocks which were solved (not trivial)
+    size_t          mec_score   = 0;        //!< The MEC score of the haplotypes
+    size_t          in_flight   = 0;        //!< The most sub-blocks in flight, within the memory cap
+    double          seconds     = 0.0;      //!< The time to phase the file (including reading it)
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      BatchRunner
+/// @brief      Phases many input files concurrently. All the jobs share the tbb task scheduler (and so its
+///             thread pool) and the allocator of the process, rather than each input starting a process.
+///             Each job is capped in memory -- every sub-block is a copy of the block, so a job which
+///             would exceed the cap has fewer sub-blocks in flight, and is skipped if even one would
+///             exceed it. The haplotypes of each file are written to the output directory, with a summary
+///             of the time and MEC score of every file.
+/// @tparam     BlockType       The type of the blocks
+/// @tparam     SubBlockType    The type of the sub-blocks
+// ----------------------------------------------------------------------------------------------------------
+template <typename BlockType, typename SubBlockType>
+class BatchRunner {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using block_type            = BlockType;
+    using driver_type           = Driver<BlockType, SubBlockType>;
+    using file_container        = std::vector<std::string>;
+    using result_container      = std::vector<BatchResult>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t max_elements = BlockType::data_container::bins *
+                                           BlockType::data_container::elements_per_bin;
+private:
+    CostModel           _model;             //!< The cost model for the solvers of every job
+    size_t              _jobs;              //!< The most files phased at once
+    size_t              _memory_cap;        //!< The most bytes each job may use (0 for no cap)
+    result_container    _results;           //!< The result of each file of the last run
+    double              _seconds;           //!< The time for the last run
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  model       The cost model for choosing the solvers
+    /// @param[in]  jobs        The most files phased at once
+    /// @param[in]  memory_cap  The most bytes each job may use, 0 for no cap
+    // ------------------------------------------------------------------------------------------------------
+    explicit BatchRunner(const CostModel& model      = CostModel(),
+                         const size_t     jobs       = BATCH_JOBS ,
+                         const size_t     memory_cap = 0          )
+    : _model(model), _jobs(std::max(jobs, size_t(1))), _memory_cap(memory_cap), _seconds(0.0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the input files from a manifest -- one file per line, blank lines are ignored
+    /// @param[in]  manifest    The manifest file
+    // ------------------------------------------------------------------------------------------------------
+    static file_container from_manifest(const std::string& manifest);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the input files which match a glob pattern (e.g geraci_0.1/*/output_*.txt)
+    /// @param[in]  pattern     The pattern to match
+    // ------------------------------------------------------------------------------------------------------
+    static file_container from_glob(const std::string& pattern);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Estimates the bytes of a copy of the block of an input -- a job uses one for the block and
+    ///             one for each sub-block in flight
+    /// @param[in]  input_bytes     The size of the input file
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t copy_bytes(const size_t input_bytes)
+    {
+        return sizeof(block_type) + BATCH_BYTES_PER_INPUT * input_bytes;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Phases the files, writing the haplotypes of each to the output directory (which is
+    ///             created if it doesn't exist), along with summary.tsv. A job whose output can't be written
+    ///             fails, and if the directory can't be created every job fails without being phased
+    /// @param[in]  inputs      The input files
+    /// @param[in]  output_dir  The directory for the output files
+    // ------------------------------------------------------------------------------------------------------
+    const result_container& run(const file_container& inputs, const std::string& output_dir);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the results of the last run, in the order of the input files
+    // ------------------------------------------------------------------------------------------------------
+    inline const result_container& results() const { return _results; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the time for the last run (in seconds)
+    // ------------------------------------------------------------------------------------------------------
+    inline double seconds() const { return _seconds; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the summary of the last run -- a line for each file and then the totals
+    /// @param[in]  output  The stream to write the summary to
+    // ------------------------------------------------------------------------------------------------------
+    void write_summary(std::ostream& output) const;
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Phases a single file
+    /// @param[in]  output_dir  The directory for the output file
+    /// @param[out] result      The result, which has the input file set
+    // ------------------------------------------------------------------------------------------------------
+    void phase(const std::string& output_dir, BatchResult& result) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Counts the elements (the values of the reads) in an input file
+    /// @param[in]  input   The input file
+    // ------------------------------------------------------------------------------------------------------
+    static size_t count_elements(const std::string& input);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the name of the output file for an input -- the path of the input with the
+    ///             separators replaced, since the inputs of a batch often have the same name
+    /// @param[in]  input   The input file
+    // ------------------------------------------------------------------------------------------------------
+    static std::string output_name(const std::string& input);
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename BlockType, typename SubBlockType>
+typename BatchRunner<BlockType, SubBlockType>::file_container
+BatchRunner<BlockType, SubBlockType>::from_manifest(const std::string& manifest)
+{
+    std::ifstream  file(manifest);
+    if (!file.is_open()) throw std::runtime_error("Could not open manifest file =(!\n");
+
+    file_container inputs;
+    std::string    line;
+    while (std::getline(file, line)) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty()) inputs.push_back(line);
+    }
+    return inputs;
+}
+
+template <typename BlockType, typename SubBlockType>
+typename BatchRunner<BlockType, SubBlockType>::file_container
+BatchRunner<BlockType, SubBlockType>::from_glob(const std::string& pattern)
+{
+    file_container inputs;
+    glob_t         matches;
+    if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; ++i) inputs.emplace_back(matches.gl_pathv[i]);
+    }
+    globfree(&matches);
+    return inputs;
+}
+
+template <typename BlockType, typename SubBlockType>
+const typename BatchRunner<BlockType, SubBlockType>::result_container&
+BatchRunner<BlockType, SubBlockType>::run(const file_container& inputs, const std::string& output_dir)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    _results.assign(inputs.size(), BatchResult());
+    for (size_t i = 0; i < inputs.size(); ++i) _results[i].input = inputs[i];
+
+    // Without the output directory nothing can be written, so every job fails without being phased
+    if (mkdir(output_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        for (auto& result : _results) {
+            result.status  = job::failed;
+            result.message = "Could not create output directory " + output_dir;
+        }
+        _seconds = 0.0;
+        return _results;
+    }
+
+    // Each job runs its own pipeline, but all the pipelines share the task scheduler
+    tbb::flow::graph graph;
+    tbb::flow::function_node<size_t> jobs(graph, _jobs,
+        [&](const size_t i) { phase(output_dir, _results[i]); }
+    );
+    for (size_t i = 0; i < inputs.size(); ++i) jobs.try_put(i);
+    graph.wait_for_all();
+    _seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::ofstream summary(output_dir + "/summary.tsv");
+    write_summary(summary);
+    if (!summary) std::cerr << "Error : Could not write the summary to " << output_dir << " =(\n";
+    return _results;
+}
+
+template <typename BlockType, typename SubBlockType>
+void BatchRunner<BlockType, SubBlockType>::write_summary(std::ostream& output) const
+{
+    size_t solved = 0, mec_score = 0;
+    double job_seconds = 0.0;
+    output << "input\tstatus\treads\tsnps\tsubblocks\tmec\tseconds\tmessage\n";
+    for (const auto& result : _results) {
+        output << result.input     << "\t" << job::names[result.status] << "\t" << result.reads     << "\t"
+               << result.snps      << "\t" << result.subblocks          << "\t" << result.mec_score << "\t"
+               << result.seconds   << "\t" << result.message            << "\n";
+        if (result.status == job::solved) { ++solved; mec_score += result.mec_score; }
+        job_seconds += result.seconds;
+    }
+    output << "# " << solved << " of " << _results.size() << " solved, total mec " << mec_score
+           << ", job time " << job_seconds << "s, wall time " << _seconds << "s\n";
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename BlockType, typename SubBlockType>
+void BatchRunner<BlockType, SubBlockType>::phase(const std::string& output_dir, BatchResult& result) const
+{
+    using namespace std::chrono;
+    const auto start = high_resolution_clock::now();
+    try {
+        struct stat info;
+        if (stat(result.input.c_str(), &info) != 0) throw std::runtime_error("Could not open input file");
+
+        // The data of the block is a fixed size, so larger inputs can't be phased
+        const size_t input_bytes = static_cast<size_t>(info.st_size);
+        if (input_bytes > max_elements && count_elements(result.input) > max_elements) {
+            result.status  = job::skipped;
+            result.message = "More elements than the block size";
+            return;
+        }
+
+        // The block and each sub-block in flight are a copy of the data and the read and snp information
+        const size_t cores      = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+        result.in_flight = DRIVER_IN_FLIGHT_FACTOR * cores;
+        if (_memory_cap > 0) {
+            const size_t copies = _memory_cap / copy_bytes(input_bytes);
+            if (copies < 2) {
+                result.status  = job::skipped;
+                result.message = "Exceeds the memory cap";
+                return;
+            }
+            result.in_flight = std::min(result.in_flight, copies - 1);
+        }
+
+        std::unique_ptr<block_type> block(new block_type(result.input.c_str()));
+        driver_type driver(_model, 0, DRIVER_BUILD_CONCURRENCY, result.in_flight);
+        driver.run(*block);
+
+        result.output = output_dir + "/" + output_name(result.input);
+        std::ofstream output(result.output);
+        block->write_haplotypes(output);
+        output.flush();
+        if (!output) throw std::runtime_error("Could not write output file " + result.output);
+
+        result.reads     = block->reads();
+        result.snps      = block->haplo_one().size();
+        result.subblocks = driver.dispatcher().log().size();
+        result.mec_score = block->mec_score();
+        result.status    = job::solved;
+    } catch (const std::exception& exception) {
+        result.status  = job::failed;
+        result.message = exception.what();
+        result.message.erase(std::remove(result.message.begin(), result.message.end(), '\n'),
+                             result.message.end());
+    }
+    result.seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+}
+
+template <typename BlockType, typename SubBlockType>
+size_t BatchRunner<BlockType, SubBlockType>::count_elements(const std::string& input)
+{
+    io::mapped_file_source file(input);
+    const char* data     = file.data();
+    size_t      elements = 0, field = 0;
+
+    // The values of a read are the third field of its line
+    for (size_t i = 0; i < file.size(); ++i) {
+        if (data[i] == '\n') {
+            field = 0;
+        } else if (data[i] == ' ' || data[i] == '\t') {
+            if (i > 0 && data[i - 1] != ' ' && data[i - 1] != '\t') ++field;
+        } else if (field == 2) {
+            ++elements;
+        }
+    }
+    return elements;
+}
+
+template <typename BlockType, typename SubBlockType>
+std::string BatchRunner<BlockType, SubBlockType>::output_name(const std::string& input)
+{
+    std::string name = input;
+    while (name.compare(0, 3, "../") == 0) name.erase(0, 3);
+    while (name.compare(0, 2, "./" ) == 0) name.erase(0, 2);
+    std::replace(name.begin(), name.end(), '/', '_');
+    return name + ".haplo";
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_BATCH_HPP
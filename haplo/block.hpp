@@ -10,13 +10,19 @@
 #include "read_info.h"
 #include "snp_info.hpp"
 #include "small_containers.h"
+#include "sparse_reads.hpp"
+#include "union_find.hpp"
 
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/tokenizer.hpp>
 #include <tbb/tbb.h>
 #include <tbb/concurrent_unordered_map.h>
+#include <tbb/parallel_scan.h>
 #include <tbb/parallel_sort.h>
 #include <thrust/host_vector.h>
+#include <algorithm>
+#include <limits>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -34,10 +40,86 @@ namespace haplo {
 #define THREE   0x03
 #define IH      0x00           // Intricically heterozygous
 #define NIH     0x01           // Not intrinsically heterozygous
+
+#ifndef TRIVIAL_MAX_COLS
+    #define TRIVIAL_MAX_COLS    3       // Sub-blocks with at most this many columns are solved directly
+#endif
+#ifndef TRIVIAL_MAX_READS
+    #define TRIVIAL_MAX_READS   10      // Sub-blocks with at most this many reads are solved directly
+#endif
+#ifndef SUBBLOCK_MAX_COVERAGE
+    #define SUBBLOCK_MAX_COVERAGE   0   // The reads to keep with a value at a sub-block column (0 for any)
+#endif
     
 namespace io = boost::iostreams;
 using namespace io;
 
+namespace align {
+
+static constexpr uint8_t none   = 0;        // There is no solution to align
+static constexpr uint8_t flip   = 1;        // Aligned by flipping the bits of both haplotypes (which is
+                                            // only the same solution when they are complementary)
+static constexpr uint8_t swap   = 2;        // Aligned by swapping the haplotypes
+
+}               // End namespace align
+
+namespace component {
+
+static constexpr size_t all     = std::numeric_limits<size_t>::max();   // All the components of a subblock
+
+}               // End namespace component
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     StagedSolution
+/// @brief      The haplotypes of a subblock which are waiting to be merged into the block, and how they are
+///             aligned with the haplotypes of the previous subblock
+// ----------------------------------------------------------------------------------------------------------
+struct StagedSolution {
+    BinaryVector<2>     haplo_one;                  //!< The first haplotype of the non monotone columns
+    BinaryVector<2>     haplo_two;                  //!< The second haplotype of the non monotone columns
+    uint8_t             alignment   = align::none;  //!< How the haplotypes are aligned (see align::)
+    bool                normalised  = false;        //!< If the haplotypes are for the normalised columns
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     PhaseMap
+/// @brief      The phase decision (if the alignment is applied) of a subblock for each decision of the
+///             previous subblock. Maps compose associatively, so the decisions of all the subblocks are a
+///             prefix scan of their maps
+// ----------------------------------------------------------------------------------------------------------
+struct PhaseMap {
+    uint8_t decision[2] = { 0, 1 };                 //!< The decision for a previous decision of 0 and 1
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Composes two maps -- the result applies this map and then the next one
+    /// @param[in]  next    The map to apply after this one
+    // ------------------------------------------------------------------------------------------------------
+    inline PhaseMap then(const PhaseMap& next) const
+    {
+        PhaseMap map;
+        map.decision[0] = next.decision[decision[0]];
+        map.decision[1] = next.decision[decision[1]];
+        return map;
+    }
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     SubBlockShape
+/// @brief      The size of a subblock, which is known before the sub-block is created, so that the cost of
+///             solving it can be estimated for scheduling
+// ----------------------------------------------------------------------------------------------------------
+struct SubBlockShape {
+    size_t  reads       = 0;                        //!< The number of non singular reads
+    size_t  snps        = 0;                        //!< The number of non monotone columns
+    size_t  elements    = 0;                        //!< The sum of the lengths of the reads
+    size_t  components  = 1;                        //!< The number of independent components of the snps
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the mean number of reads spanning a snp
+    // ------------------------------------------------------------------------------------------------------
+    inline double coverage() const { return snps > 0 ? static_cast<double>(elements) / snps : 0.0; }
+};
+
 // ----------------------------------------------------------------------------------------------------------
 /// @class      Block 
 /// @brief      Represents a block of input the for which the haplotypes must be determined
@@ -51,11 +133,17 @@ public:
     // ----------------------------------------- TYPES ALIAS'S ----------------------------------------------
     using data_container        = BinaryArray<Elements, 2>;    
     using binary_vector         = BinaryVector<2>;
+    using mask_vector           = BinaryVector<1>;
     using atomic_type           = tbb::atomic<size_t>;
     using atomic_vector         = tbb::concurrent_vector<size_t>;
     using read_info_container   = thrust::host_vector<ReadInfo>;
     using snp_info_container    = tbb::concurrent_unordered_map<size_t, SnpInfo>;
     using concurrent_umap       = tbb::concurrent_unordered_map<size_t, uint8_t>;
+    using index_container       = std::vector<size_t>;
+    using reads_container       = std::vector<index_container>;
+    using staged_container      = std::vector<StagedSolution>;
+    using shape_container       = std::vector<SubBlockShape>;
+    using component_container   = std::vector<index_container>;
     // ------------------------------------------------------------------------------------------------------
 private:
     size_t              _rows;                  //!< The number of reads in the input data
@@ -64,9 +152,17 @@ private:
     size_t              _last_aligned;          //!< The last aligned value
     data_container      _data;                  //!< Container for { '0' | '1' | '-' } data variables
     read_info_container _read_info;             //!< Information about each read (row)
+    SparseReads         _sparse;                //!< The values of the reads which are mostly gaps
     snp_info_container  _snp_info;              //!< Information about each snp (col)
-    concurrent_umap     _flipped_cols;          //!< Columns which have been flipped
+    mask_vector         _flip_mask;             //!< Columns with more ones than zeros (to normalise)
+    bool                _normalise;             //!< If sub-blocks see the normalised columns
+    size_t              _max_coverage;          //!< The most reads of a sub-block at a column (0 for any)
     atomic_vector       _splittable_cols;       //!< A vector of splittable columns
+    std::vector<bool>   _trivial;               //!< If each subblock is small enough to solve directly
+    reads_container     _trivial_reads;         //!< The non singular reads of each trivial subblock
+    shape_container     _shapes;                //!< The size of each subblock
+    component_container _components;            //!< The component of each snp of each subblock (or none)
+    staged_container    _staged;                //!< The solutions of each subblock waiting to be merged
     
     // Solutions for the entire block 
     binary_vector       _haplo_one;             //!< The first haplotype
@@ -84,6 +180,57 @@ public:
     /// @param[in]  col_idx     The column index of the element
     // ------------------------------------------------------------------------------------------------------
     uint8_t operator()(const size_t row_idx, const size_t col_idx) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of an element, as for operator(), but with the column normalised (the bits
+    ///             flipped if the column has more ones than zeros) when normalisation is enabled -- this
+    ///             is the value that sub-blocks are created from
+    /// @param[in]  row_idx     The row index of the element
+    /// @param[in]  col_idx     The column index of the element
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t normalised(const size_t row_idx, const size_t col_idx) const
+    {
+        const uint8_t value = operator()(row_idx, col_idx);
+        return value <= ONE ? value ^ column_flip(col_idx) : value;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Enables or disables column normalisation for the sub-blocks -- the data is not modified,
+    ///             the flips are applied as elements are read, so this can be set per solver, but must not
+    ///             change between creating a sub-block and merging its haplotypes
+    /// @param[in]  normalise   If the sub-blocks should see normalised columns
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_normalise(const bool normalise) { _normalise = normalise; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if column normalisation is enabled
+    // ------------------------------------------------------------------------------------------------------
+    inline bool normalise() const { return _normalise; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the most reads which a sub-block keeps with a value at any column -- the most
+    ///             informative reads are kept, and the reads which are dropped aren't phased, but still count
+    ///             in the MEC score of the block. The cap is soft: a read which has the only value of a
+    ///             column is always kept, even if its other columns are at the cap, so that no column is
+    ///             lost. Must not change while sub-blocks are created
+    /// @param[in]  max_coverage    The most reads at a column, 0 to keep all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_max_coverage(const size_t max_coverage) { _max_coverage = max_coverage; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most reads which a sub-block keeps with a value at any column (0 for any)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_coverage() const { return _max_coverage; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns 1 if the values of a column are flipped by normalisation, otherwise 0 -- returns
+    ///             0 if normalisation is disabled or the index is out of range
+    /// @param[in]  i   The index of the column
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t column_flip(const size_t i) const
+    {
+        return _normalise && i < _cols ? _flip_mask.get(i) : 0;
+    }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the number of subblocks in the block
@@ -130,7 +277,12 @@ public:
     /// @brief      Gets the information for a read
     /// @param[in]  i   The index of the read (row)
     // ------------------------------------------------------------------------------------------------------
-    inline const ReadInfo& read_info(const size_t i) const { return _read_info[i]; }    
+    inline const ReadInfo& read_info(const size_t i) const { return _read_info[i]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the values of the reads which are mostly gaps
+    // ------------------------------------------------------------------------------------------------------
+    inline const SparseReads& sparse_reads() const { return _sparse; }    
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      The number of reads in the block (total number of rows)
@@ -138,17 +290,157 @@ public:
     inline size_t reads() const { return _rows; }
 
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Merges the haplotype solution of a sub block into the final solution
+    /// @brief      A reference to the first haplotype of the block
+    // ------------------------------------------------------------------------------------------------------
+    inline const binary_vector& haplo_one() const { return _haplo_one; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      A reference to the second haplotype of the block
+    // ------------------------------------------------------------------------------------------------------
+    inline const binary_vector& haplo_two() const { return _haplo_two; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges the haplotype solution of a sub block into the final solution, swapping the
+    ///             haplotypes if need be to align them with the previous sub block
     /// @param[in]  sub_block       The sub-block to get the solution from 
     /// @tparam     SubBlockType    The type of the sub-block
     // ------------------------------------------------------------------------------------------------------
     template <typename SubBlockType>
     void merge_haplotype(const SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Stages the haplotype solution of a sub block, to be merged with the solutions of the other
+    ///             sub blocks by merge_haplotypes -- sub blocks can be staged concurrently, in any order
+    /// @param[in]  sub_block       The sub-block to get the solution from 
+    /// @tparam     SubBlockType    The type of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    template <typename SubBlockType>
+    void stage_haplotype(const SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Stages the haplotypes of a subblock, as for stage_haplotype, when the sub block itself
+    ///             no longer exists
+    /// @param[in]  i           The index of the subblock
+    /// @param[in]  haplo_one   The first haplotype for the non monotone columns of the subblock
+    /// @param[in]  haplo_two   The second haplotype for the non monotone columns of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    void stage_solution(const size_t i, const binary_vector& haplo_one, const binary_vector& haplo_two);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges all the staged solutions into the final solution, giving the same haplotypes as
+    ///             merging them in order (with merge_haplotype and solve_trivial, which align each subblock
+    ///             by swapping its haplotypes, as the staged solutions are). The alignment decision of each
+    ///             subblock depends only on the decision of the previous one, so the decisions are resolved
+    ///             by a parallel prefix scan, and then the columns are written in parallel
+    // ------------------------------------------------------------------------------------------------------
+    void merge_haplotypes();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if a subblock is small enough (in columns or in reads) to be solved directly,
+    ///             without creating a SubBlock -- returns false if the index is out of range
+    /// @param[in]  i   The index of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_trivial(const size_t i) const { return i < _trivial.size() ? _trivial[i] : false; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the size of a subblock (its reads, snps and elements) -- the size is empty if the
+    ///             index is out of range. With a coverage cap the reads and elements are scaled down to
+    ///             about what the sub-block keeps, so that its cost estimate follows the cap
+    /// @param[in]  i   The index of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    inline SubBlockShape subblock_shape(const size_t i) const
+    {
+        if (i >= _shapes.size()) return SubBlockShape();
+        SubBlockShape shape = _shapes[i];
+        if (_max_coverage > 0 && shape.coverage() > _max_coverage) {
+            const double kept = _max_coverage / shape.coverage();
+            shape.reads    = static_cast<size_t>(shape.reads * kept + 0.5);
+            shape.elements = static_cast<size_t>(shape.elements * kept + 0.5);
+        }
+        return shape;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the component of each non monotone column of a subblock -- the columns are in the
+    ///             same component when a read links them (through the columns it has a 0 or 1 in), so the
+    ///             components can be phased independently. Empty if the subblock has only one component
+    /// @param[in]  i   The index of the subblock (which must be in range)
+    // ------------------------------------------------------------------------------------------------------
+    inline const index_container& column_components(const size_t i) const { return _components[i]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a trivial subblock and merges the solution into the haplotypes. A single column
+    ///             is the majority and its complement, a few columns are solved by trying all of the
+    ///             haplotypes, and a few reads by trying all of the bipartitions of the reads
+    /// @param[in]  i   The index of the subblock
+    /// @return     False if the subblock is not trivial, in which case nothing is done
+    // ------------------------------------------------------------------------------------------------------
+    bool solve_trivial(const size_t i);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a trivial subblock, as for solve_trivial, but stages the solution to be merged by
+    ///             merge_haplotypes -- subblocks can be staged concurrently
+    /// @param[in]  i   The index of the subblock
+    /// @return     False if the subblock is not trivial, in which case nothing is done
+    // ------------------------------------------------------------------------------------------------------
+    bool stage_trivial(const size_t i);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Makes the staged solution of a subblock from its haplotypes, without staging it. The
+    ///             haplotypes are aligned by swapping them, since the solvers leave the NIH columns free, so
+    ///             the complement of the haplotypes is not in general a solution
+    /// @param[in]  haplo_one   The first haplotype for the non monotone columns of the subblock
+    /// @param[in]  haplo_two   The second haplotype for the non monotone columns of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    StagedSolution staged_solution(const binary_vector& haplo_one, const binary_vector& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a trivial subblock, as for stage_trivial, but without staging the solution
+    /// @param[in]  i       The index of the subblock
+    /// @param[out] staged  The solution of the subblock
+    /// @return     False if the subblock is not trivial, in which case nothing is done
+    // ------------------------------------------------------------------------------------------------------
+    bool trivial_solution(const size_t i, StagedSolution& staged) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Aligns the solution of a subblock with the previous one and gets the values of all of its
+    ///             columns (start to end, inclusive), as merging the subblocks in order sets them. The block
+    ///             is not modified, so regions can be aligned while sub-blocks are being built from it
+    /// @param[in]  i           The index of the subblock
+    /// @param[in]  staged      The solution of the subblock
+    /// @param[in]  previous    The value of the first haplotype at the start column of the subblock, which
+    ///             the previous subblock returned (0 for the first subblock)
+    /// @param[out] haplo_one   The first haplotype for the columns of the subblock
+    /// @param[out] haplo_two   The second haplotype for the columns of the subblock
+    /// @return     The value of the first haplotype at the end column (the previous value for the next one)
+    // ------------------------------------------------------------------------------------------------------
+    uint8_t aligned_region(const size_t   i        , const StagedSolution& staged   , const uint8_t previous,
+                           binary_vector& haplo_one, binary_vector&        haplo_two) const;
     
    // ------------------------------------------------------------------------------------------------------
     /// @brief      Determines the MEC score of the haplotpye 
     // ------------------------------------------------------------------------------------------------------
     void determine_mec_score() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the haplotypes -- the fewest elements which must be corrected for
+    ///             each read to match one of the haplotypes
+    // ------------------------------------------------------------------------------------------------------
+    size_t mec_score() const { return mec_score(_haplo_one, _haplo_two); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of haplotypes for all the columns of the block (for haplotypes which
+    ///             were phased elsewhere, such as the merged haplotypes of shards of the block)
+    /// @param[in]  haplo_one   The first haplotype
+    /// @param[in]  haplo_two   The second haplotype
+    // ------------------------------------------------------------------------------------------------------
+    size_t mec_score(const binary_vector& haplo_one, const binary_vector& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the haplotypes to a stream, one haplotype per line, a line at a time
+    /// @param[in]  output  The stream to write the haplotypes to
+    // ------------------------------------------------------------------------------------------------------
+    void write_haplotypes(std::ostream& output) const;
     
     void print_haplotypes() const 
     {
@@ -169,13 +461,10 @@ private:
     void fill(const char* data_file);
     
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Flips all elements of a column if there are more ones than zeros, and records that the
-    ///             column has been flipped
-    /// @param[in]  col_idx         The index of the column to flip
-    /// @param[in]  col_start_row   The start row of the column
-    /// @param[in]  col_end_row     The end row of the column
+    /// @brief      Sets the flip mask -- the non monotone columns with more ones than zeros. Each bin of the
+    ///             mask is set by a single thread, so the bins are set in parallel
     // ------------------------------------------------------------------------------------------------------
-    void flip_column_bits(const size_t col_idx, const size_t col_start_row, const size_t col_end_row);
+    void set_flip_mask();
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Processes a line of data
@@ -188,8 +477,7 @@ private:
     size_t process_data(size_t offset, TokenPointer& line);
 
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Processses a snp (column), checking if it is IH or NIH, and if it is montone, or flipping 
-    ///             the bits if it has more ones than zeros
+    /// @brief      Processses a snp (column), checking if it is IH or NIH, and if it is montone
     // ------------------------------------------------------------------------------------------------------
     void process_snps(); 
     
@@ -206,6 +494,79 @@ private:
     ///             from the start of the vector
     // ------------------------------------------------------------------------------------------------------
     void sort_splittable_cols();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the subblocks which are small enough to solve directly, and their reads
+    // ------------------------------------------------------------------------------------------------------
+    void find_trivial_subblocks();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the components of the non monotone columns of a subblock, with a union find over
+    ///             the columns which each read has a value in. Columns which no read has a value in carry no
+    ///             information, so are put in the component of the column before them
+    /// @param[in]  i       The index of the subblock
+    /// @param[in]  reads   The non singular reads of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    void find_components(const size_t i, const index_container& reads);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges the haplotypes of the non monotone columns of a subblock into the final solution
+    /// @param[in]  i           The index of the subblock
+    /// @param[in]  haplo_one   The first haplotype for the non monotone columns of the subblock
+    /// @param[in]  haplo_two   The second haplotype for the non monotone columns of the subblock
+    /// @param[in]  normalised  If the haplotypes are for the normalised columns
+    /// @param[in]  alignment   How the haplotypes are aligned with the previous subblock (align::flip or
+    ///             align::swap)
+    // ------------------------------------------------------------------------------------------------------
+    void merge_solution(const size_t         i        , const binary_vector& haplo_one ,
+                        const binary_vector& haplo_two, const bool           normalised,
+                        const uint8_t        alignment);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the haplotypes of a trivial subblock
+    /// @param[in]  i           The index of the subblock
+    /// @param[out] haplo_one   The first haplotype for the non monotone columns of the subblock
+    /// @param[out] haplo_two   The second haplotype for the non monotone columns of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    void trivial_haplotypes(const size_t i, binary_vector& haplo_one, binary_vector& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value (un-normalised) of a staged haplotype at a column, after its alignment
+    /// @param[in]  staged      The staged solution of the subblock
+    /// @param[in]  haplo       The haplotype (0 for the first, 1 for the second)
+    /// @param[in]  haplo_idx   The index in the haplotype (of the non monotone columns of the subblock)
+    /// @param[in]  col_idx     The column of the block which the index is for
+    /// @param[in]  aligned     If the alignment is applied
+    // ------------------------------------------------------------------------------------------------------
+    uint8_t staged_value(const StagedSolution& staged, const uint8_t haplo  , const size_t haplo_idx,
+                         const size_t          col_idx, const uint8_t aligned) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the phase map of a staged subblock -- its decision to align, as merge_solution
+    ///             and solve_trivial decide it, for each decision of the previous subblock
+    /// @param[in]  i   The index of the subblock
+    // ------------------------------------------------------------------------------------------------------
+    PhaseMap phase_map(const size_t i) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the haplotypes with the lowest MEC score by trying all of them
+    /// @param[in]  cols        The non monotone columns of the subblock
+    /// @param[in]  reads       The reads of the subblock
+    /// @param[out] haplo_one   The first haplotype
+    /// @param[out] haplo_two   The second haplotype
+    // ------------------------------------------------------------------------------------------------------
+    void search_haplotypes(const index_container& cols     , const index_container& reads    ,
+                           binary_vector&         haplo_one, binary_vector&         haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the bipartition of the reads with the lowest MEC score by trying all of them
+    /// @param[in]  cols        The non monotone columns of the subblock
+    /// @param[in]  reads       The reads of the subblock
+    /// @param[out] haplo_one   The first haplotype
+    /// @param[out] haplo_two   The second haplotype
+    // ------------------------------------------------------------------------------------------------------
+    void search_bipartitions(const index_container& cols     , const index_container& reads    ,
+                             binary_vector&         haplo_one, binary_vector&         haplo_two) const;
 };
 
 // ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
@@ -214,13 +575,19 @@ private:
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
 Block<Elements, ThreadsX, ThreadsY>::Block(const char* data_file)
-: _rows{0}, _cols{0}, _first_splittable{0}, _last_aligned{0}, _read_info{0}, _splittable_cols{0} 
+: _rows{0}, _cols{0}, _first_splittable{0}, _last_aligned{0}, _read_info{0}, _normalise{false},
+  _max_coverage{SUBBLOCK_MAX_COVERAGE}, _splittable_cols{0}
 {
     fill(data_file);                    // Get the data from the input file
+
+    // Index the reads which are mostly gaps, so that scans of them skip the gaps
+    _sparse.build(_rows, [&](const size_t row_idx) -> const ReadInfo& { return _read_info[row_idx]; },
+                  [&](const size_t row_idx, const size_t col_idx) { return operator()(row_idx, col_idx); });
     process_snps();                     // Process the SNPs to determine block params
     
     // Resize the haplotypes
     _haplo_one.resize(_cols); _haplo_two.resize(_cols); 
+    _staged.resize(num_subblocks());
 } 
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
@@ -234,16 +601,226 @@ uint8_t Block<Elements, ThreadsX, ThreadsY>::operator()(const size_t row_idx, co
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename SubBlockType>
 void Block<Elements, ThreadsX, ThreadsY>::merge_haplotype(const SubBlockType& sub_block)
 {
-    const size_t start_col = _splittable_cols[sub_block.index() + _first_splittable];            
-    const size_t end_col   = _splittable_cols[sub_block.index() + _first_splittable + 1];        
-    size_t sub_haplo_idx   = 0;                             // Haplo idx in sub block
-    bool   flip_all        = false;                         // If we need to flip all the bits 
-  
     if (sub_block.index() == 0) _last_aligned = sub_block.base_start_row() - 2;
+    merge_solution(sub_block.index(), sub_block.haplo_one(), sub_block.haplo_two(), _normalise, align::swap);
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename SubBlockType>
+void Block<Elements, ThreadsX, ThreadsY>::stage_haplotype(const SubBlockType& sub_block)
+{
+    if (sub_block.index() == 0) _last_aligned = sub_block.base_start_row() - 2;
+    stage_solution(sub_block.index(), sub_block.haplo_one(), sub_block.haplo_two());
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::stage_solution(const size_t         i        ,
+                                                         const binary_vector& haplo_one,
+                                                         const binary_vector& haplo_two)
+{
+    _staged[i] = staged_solution(haplo_one, haplo_two);
+}
 
-    // Check if we need to flip all bits
-    if (_haplo_one.get(start_col) != sub_block.haplo_one().get(0) && !is_monotone(start_col))
-        flip_all = true;
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::merge_haplotypes()
+{
+    const size_t subblocks = _staged.size();
+    if (subblocks == 0) return;
+
+    // Each decision depends only on the previous one, so find the maps and then scan them
+    std::vector<PhaseMap> maps(subblocks);
+    std::vector<uint8_t>  decisions(subblocks, 0);
+    tbb::parallel_for(size_t(0), subblocks, [&](const size_t i) { maps[i] = phase_map(i); });
+    tbb::parallel_scan(
+        tbb::blocked_range<size_t>(0, subblocks), PhaseMap(),
+        [&](const tbb::blocked_range<size_t>& range, PhaseMap prefix, const bool is_final)
+        {
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                prefix = prefix.then(maps[i]);
+                if (is_final) decisions[i] = prefix.decision[0];
+            }
+            return prefix;
+        },
+        [](const PhaseMap& left, const PhaseMap& right) { return left.then(right); }
+    );
+
+    // The index of each column in the haplotypes of its subblock is the number of non monotone columns
+    // from the start of the subblock
+    index_container non_monotone(_cols + 1, 0);
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx)
+        non_monotone[col_idx + 1] = non_monotone[col_idx] + !is_monotone(col_idx);
+
+    // A subblock owns the columns up to the start of the next subblock, and its end column too if the next
+    // subblock is not staged, as the later subblock overwrites the shared column when merging in order
+    const auto first = _splittable_cols.begin() + _first_splittable;
+    const auto last  = _splittable_cols.end();
+    auto owner = [&](const size_t col_idx)
+    {
+        const auto next = std::upper_bound(first, last, col_idx);
+        if (next == first) return subblocks;
+        const size_t i = (next - first) - 1;
+        if (i < subblocks && _staged[i].alignment != align::none && next != last) return i;
+        if (i > 0 && col_idx == subblock(i) && _staged[i - 1].alignment != align::none) return i - 1;
+        return subblocks;
+    };
+
+    // Each task writes whole bins of the haplotypes, so no two tasks write the same bin
+    constexpr size_t bin_size = binary_vector::elements_per_bin;
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _cols / bin_size + 1),
+        [&](const tbb::blocked_range<size_t>& bins)
+        {
+            for (size_t col_idx = bins.begin() * bin_size; col_idx < std::min(bins.end() * bin_size, _cols);
+                 ++col_idx) {
+                const size_t i = owner(col_idx);
+                if (i == subblocks) continue;
+
+                if (is_monotone(col_idx)) {
+                    _haplo_one.set(col_idx, operator()(_snp_info.at(col_idx).start_index(), col_idx));
+                    _haplo_two.set(col_idx, operator()(_snp_info.at(col_idx).start_index(), col_idx));
+                } else {
+                    const size_t haplo_idx = non_monotone[col_idx] - non_monotone[subblock(i)];
+                    _haplo_one.set(col_idx, staged_value(_staged[i], 0, haplo_idx, col_idx, decisions[i]));
+                    _haplo_two.set(col_idx, staged_value(_staged[i], 1, haplo_idx, col_idx, decisions[i]));
+                }
+            }
+        }
+    );
+
+    for (auto& staged : _staged) staged = StagedSolution();
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+bool Block<Elements, ThreadsX, ThreadsY>::solve_trivial(const size_t i)
+{
+    if (!is_trivial(i)) return false;
+
+    binary_vector haplo_one, haplo_two;
+    trivial_haplotypes(i, haplo_one, haplo_two);
+
+    // The haplotypes are interchangeable, so align them with the previous subblock by swapping them -- the
+    // complement of a solution with NIH columns is not a solution
+    merge_solution(i, haplo_one, haplo_two, false, align::swap);
+    return true;
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+bool Block<Elements, ThreadsX, ThreadsY>::stage_trivial(const size_t i)
+{
+    return trivial_solution(i, _staged[i]);
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+StagedSolution Block<Elements, ThreadsX, ThreadsY>::staged_solution(const binary_vector& haplo_one,
+                                                                    const binary_vector& haplo_two) const
+{
+    StagedSolution staged;
+    staged.haplo_one  = haplo_one;
+    staged.haplo_two  = haplo_two;
+    staged.alignment  = align::swap;
+    staged.normalised = _normalise;
+    return staged;
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+bool Block<Elements, ThreadsX, ThreadsY>::trivial_solution(const size_t i, StagedSolution& staged) const
+{
+    if (!is_trivial(i)) return false;
+
+    trivial_haplotypes(i, staged.haplo_one, staged.haplo_two);
+    staged.alignment  = align::swap;
+    staged.normalised = false;
+    return true;
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+uint8_t Block<Elements, ThreadsX, ThreadsY>::aligned_region(const size_t          i        ,
+                                                            const StagedSolution& staged   ,
+                                                            const uint8_t         previous ,
+                                                            binary_vector&        haplo_one,
+                                                            binary_vector&        haplo_two) const
+{
+    const size_t  start_col = subblock(i), end_col = subblock(i + 1);
+    const uint8_t aligned   = !is_monotone(start_col) && staged.haplo_one.size() > 0 &&
+                              previous != staged_value(staged, 0, 0, start_col, 0);
+
+    haplo_one.resize(end_col - start_col + 1); haplo_two.resize(end_col - start_col + 1);
+    for (size_t col_idx = start_col, haplo_idx = 0; col_idx <= end_col; ++col_idx) {
+        if (is_monotone(col_idx)) {
+            haplo_one.set(col_idx - start_col, operator()(_snp_info.at(col_idx).start_index(), col_idx));
+            haplo_two.set(col_idx - start_col, operator()(_snp_info.at(col_idx).start_index(), col_idx));
+        } else {
+            haplo_one.set(col_idx - start_col, staged_value(staged, 0, haplo_idx, col_idx, aligned));
+            haplo_two.set(col_idx - start_col, staged_value(staged, 1, haplo_idx, col_idx, aligned));
+            ++haplo_idx;
+        }
+    }
+    return haplo_one.get(end_col - start_col);
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+size_t Block<Elements, ThreadsX, ThreadsY>::mec_score(const binary_vector& haplo_one,
+                                                      const binary_vector& haplo_two) const
+{
+    size_t mec_score = 0;
+    
+    for (size_t read_idx = 0; read_idx < _rows; ++read_idx) {
+        // Elements outside the read don't exist, so only the values of the read contribute
+        size_t contrib_one = 0, contrib_two = 0;
+        const size_t end_idx = std::min(_read_info[read_idx].end_index() + 1, _cols);
+        _sparse.for_each_value(read_idx, _read_info[read_idx].start_index(), end_idx - 1,
+            [&](const size_t haplo_idx) { return operator()(read_idx, haplo_idx); },
+            [&](const size_t haplo_idx, const uint8_t value)
+            {
+                if (haplo_one.get(haplo_idx) != value) ++contrib_one;
+                if (haplo_two.get(haplo_idx) != value) ++contrib_two;
+            }
+        );
+        // Add the minimum contribution 
+        mec_score += std::min(contrib_one, contrib_two);
+    }
+    return mec_score;
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::determine_mec_score() const 
+{
+    std::cout << "MEC SCORE : " << mec_score() << "\n";
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::write_haplotypes(std::ostream& output) const
+{
+    std::string line(_haplo_one.size(), '0');
+    for (size_t i = 0; i < _haplo_one.size(); ++i) line[i] = static_cast<char>('0' + _haplo_one.get(i));
+    output << line << "\n";
+    for (size_t i = 0; i < _haplo_two.size(); ++i) line[i] = static_cast<char>('0' + _haplo_two.get(i));
+    output << line << "\n";
+}
+
+// ------------------------------------------------- PRIVATE ------------------------------------------------
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::merge_solution(const size_t         i         ,
+                                                         const binary_vector& haplo_one ,
+                                                         const binary_vector& haplo_two ,
+                                                         const bool           normalised,
+                                                         const uint8_t        alignment )
+{
+    const size_t start_col = _splittable_cols[i + _first_splittable];
+    const size_t end_col   = _splittable_cols[i + _first_splittable + 1];
+    size_t sub_haplo_idx   = 0;                             // Haplo idx in sub block
+    uint8_t flip_all       = 0;                             // If we need to flip all the bits 
+
+    // The flip of a column from normalisation, which is undone when merging
+    auto col_flip = [&](const size_t col_idx) -> uint8_t { return normalised ? column_flip(col_idx) : 0; };
+
+    // Check if we need to align the haplotypes (comparing the un-normalised values)
+    const bool aligned = !is_monotone(start_col) &&
+                         _haplo_one.get(start_col) != (haplo_one.get(0) ^ col_flip(start_col));
+    if (aligned && alignment == align::flip) flip_all = 1;
+    const bool swap    = aligned && alignment == align::swap;
+    const auto& values_one = swap ? haplo_two : haplo_one;
+    const auto& values_two = swap ? haplo_one : haplo_two;
     
     // Go over all the columns and set the haplotypes 
     for (size_t col_idx = start_col; col_idx <= end_col; ++ col_idx) {
@@ -252,47 +829,161 @@ void Block<Elements, ThreadsX, ThreadsY>::merge_haplotype(const SubBlockType& su
             _haplo_one.set(col_idx, operator()(_snp_info[col_idx].start_index(), col_idx));
             _haplo_two.set(col_idx, operator()(_snp_info[col_idx].start_index(), col_idx));
         } else {
-            // We need to get the solution from the sub block, but first check if this is a flipped column
-            if ((_flipped_cols.find(col_idx) != _flipped_cols.end() && !flip_all) || flip_all) {
-                // We flip the bits from the haplotype
-                _haplo_one.set(col_idx, !sub_block.haplo_one().get(sub_haplo_idx));
-                _haplo_two.set(col_idx, !sub_block.haplo_two().get(sub_haplo_idx));
-                ++sub_haplo_idx;
-            } else {
-                // We don't need to flip any of the bits
-                _haplo_one.set(col_idx, sub_block.haplo_one().get(sub_haplo_idx));
-                _haplo_two.set(col_idx, sub_block.haplo_two().get(sub_haplo_idx));
-                ++sub_haplo_idx;  
-            }   
+            // The subblock flip and the normalisation flip of the column compose
+            const uint8_t flip = flip_all ^ col_flip(col_idx);
+            _haplo_one.set(col_idx, values_one.get(sub_haplo_idx) ^ flip);
+            _haplo_two.set(col_idx, values_two.get(sub_haplo_idx) ^ flip);
+            ++sub_haplo_idx;
         }
     }
 }
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
-void Block<Elements, ThreadsX, ThreadsY>::determine_mec_score() const 
+void Block<Elements, ThreadsX, ThreadsY>::trivial_haplotypes(const size_t   i        ,
+                                                             binary_vector& haplo_one,
+                                                             binary_vector& haplo_two) const
 {
-    size_t mec_score = 0;
-    
-    for (size_t read_idx = 0; read_idx < _rows; ++read_idx) {
-        size_t contrib_one = 0, contrib_two = 0;
-        for (size_t haplo_idx = 0; haplo_idx < _cols; ++haplo_idx) {
-            // For the first haplotype
-            if (_haplo_one.get(haplo_idx) != operator()(read_idx, haplo_idx) &&
-                operator()(read_idx, haplo_idx) <= 1                        ) {
-                    ++contrib_one;
+    const auto&     reads = _trivial_reads[i];
+    index_container cols;
+    for (size_t col_idx = subblock(i); col_idx <= subblock(i + 1); ++col_idx)
+        if (!is_monotone(col_idx)) cols.push_back(col_idx);
+
+    haplo_one.resize(cols.size()); haplo_two.resize(cols.size());
+    if (cols.size() == 1 || reads.empty()) {
+        // Each column is independent, so use the majority and its complement
+        for (size_t c = 0; c < cols.size(); ++c) {
+            size_t zeros = 0, ones = 0;
+            for (const auto read_idx : reads) {
+                const auto value = operator()(read_idx, cols[c]);
+                if (value == ZERO) ++zeros;
+                if (value == ONE ) ++ones;
             }
-            if (_haplo_two.get(haplo_idx) != operator()(read_idx, haplo_idx) &&
-                operator()(read_idx, haplo_idx) <= 1                        ) {
-                    ++contrib_two;
+            haplo_one.set(c, zeros >= ones ? ZERO : ONE);
+            haplo_two.set(c, zeros >= ones ? ONE  : ZERO);
+        }
+    } else if (cols.size() <= TRIVIAL_MAX_COLS) {
+        search_haplotypes(cols, reads, haplo_one, haplo_two);
+    } else {
+        search_bipartitions(cols, reads, haplo_one, haplo_two);
+    }
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+uint8_t Block<Elements, ThreadsX, ThreadsY>::staged_value(const StagedSolution& staged   ,
+                                                          const uint8_t         haplo    ,
+                                                          const size_t          haplo_idx,
+                                                          const size_t          col_idx  ,
+                                                          const uint8_t         aligned  ) const
+{
+    const uint8_t flip   = staged.normalised ? column_flip(col_idx) : 0;
+    const bool    swap   = aligned && staged.alignment == align::swap;
+    const auto&   values = (haplo == 0) != swap ? staged.haplo_one : staged.haplo_two;
+    return values.get(haplo_idx) ^ flip ^ (aligned && staged.alignment == align::flip ? 1 : 0);
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+PhaseMap Block<Elements, ThreadsX, ThreadsY>::phase_map(const size_t i) const
+{
+    PhaseMap map;
+    const auto& staged = _staged[i];
+    if (staged.alignment == align::none) return map;
+
+    // Not aligned if the subblock starts with a monotone column (or has no columns)
+    const size_t start_col = subblock(i);
+    if (is_monotone(start_col) || staged.haplo_one.size() == 0) {
+        map.decision[0] = map.decision[1] = 0;
+        return map;
+    }
+
+    // Aligned if the value the previous subblock leaves at the start column differs from the first value
+    const uint8_t value = staged_value(staged, 0, 0, start_col, 0);
+    if (i > 0 && _staged[i - 1].alignment != align::none && _staged[i - 1].haplo_one.size() > 0) {
+        const size_t last = _staged[i - 1].haplo_one.size() - 1;
+        for (uint8_t previous = 0; previous < 2; ++previous)
+            map.decision[previous] = staged_value(_staged[i - 1], 0, last, start_col, previous) != value;
+    } else {
+        map.decision[0] = map.decision[1] = _haplo_one.get(start_col) != value;
+    }
+    return map;
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::search_haplotypes(const index_container& cols     ,
+                                                            const index_container& reads    ,
+                                                            binary_vector&         haplo_one,
+                                                            binary_vector&         haplo_two) const
+{
+    // IH columns have complementary haplotypes (2 choices), NIH columns are free (4 choices)
+    size_t combinations = 1;
+    for (const auto col_idx : cols) combinations *= is_intrin_hetro(col_idx) ? 2 : 4;
+
+    size_t best_cost = std::numeric_limits<size_t>::max(), best_combination = 0;
+    for (size_t combination = 0; combination < combinations; ++combination) {
+        size_t cost = 0;
+        for (const auto read_idx : reads) {
+            size_t contrib_one = 0, contrib_two = 0, choices = combination;
+            for (const auto col_idx : cols) {
+                const size_t  radix     = is_intrin_hetro(col_idx) ? 2 : 4;
+                const uint8_t value_one = choices % 2;
+                const uint8_t value_two = radix == 2 ? !value_one : (choices / 2) % 2;
+                const uint8_t value     = operator()(read_idx, col_idx);
+                choices /= radix;
+
+                if (value <= ONE && value != value_one) ++contrib_one;
+                if (value <= ONE && value != value_two) ++contrib_two;
             }
+            cost += std::min(contrib_one, contrib_two);
         }
-        // Add the minimum contribution 
-        mec_score += std::min(contrib_one, contrib_two);
+        if (cost < best_cost) { best_cost = cost; best_combination = combination; }
+    }
+
+    for (size_t c = 0; c < cols.size(); ++c) {
+        const size_t radix = is_intrin_hetro(cols[c]) ? 2 : 4;
+        haplo_one.set(c, best_combination % 2);
+        haplo_two.set(c, radix == 2 ? !(best_combination % 2) : (best_combination / 2) % 2);
+        best_combination /= radix;
     }
-    std::cout << "MEC SCORE : " << mec_score << "\n";
 }
 
-// ------------------------------------------------- PRIVATE ------------------------------------------------
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::search_bipartitions(const index_container& cols     ,
+                                                              const index_container& reads    ,
+                                                              binary_vector&         haplo_one,
+                                                              binary_vector&         haplo_two) const
+{
+    // The first read is always in set one, since swapping the sets gives the same score
+    size_t best_cost = std::numeric_limits<size_t>::max(), best_mask = 0;
+    for (size_t mask = 0; mask < (size_t(1) << (reads.size() - 1)); ++mask) {
+        size_t cost = 0;
+        for (const auto col_idx : cols) {
+            size_t counts[4] = {0, 0, 0, 0};
+            for (size_t i = 0; i < reads.size(); ++i) {
+                const uint8_t value = operator()(reads[i], col_idx);
+                if (value <= ONE) ++counts[2 * (i > 0 ? (mask >> (i - 1)) & 1 : 0) + value];
+            }
+            cost += is_intrin_hetro(col_idx)
+                  ? std::min(counts[1] + counts[2], counts[0] + counts[3])
+                  : std::min(counts[0], counts[1]) + std::min(counts[2], counts[3]);
+        }
+        if (cost < best_cost) { best_cost = cost; best_mask = mask; }
+    }
+
+    // Set the haplotypes to the consensus of each set
+    for (size_t c = 0; c < cols.size(); ++c) {
+        size_t counts[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < reads.size(); ++i) {
+            const uint8_t value = operator()(reads[i], cols[c]);
+            if (value <= ONE) ++counts[2 * (i > 0 ? (best_mask >> (i - 1)) & 1 : 0) + value];
+        }
+        if (is_intrin_hetro(cols[c])) {
+            const uint8_t value = counts[1] + counts[2] <= counts[0] + counts[3] ? ZERO : ONE;
+            haplo_one.set(c, value); haplo_two.set(c, !value);
+        } else {
+            haplo_one.set(c, counts[0] >= counts[1] ? ZERO : ONE);
+            haplo_two.set(c, counts[2] >= counts[3] ? ZERO : ONE);
+        }
+    }
+}
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
 void Block<Elements, ThreadsX, ThreadsY>::fill(const char* data_file)
@@ -365,8 +1056,7 @@ size_t Block<Elements, ThreadsX, ThreadsY>::process_data(size_t         offset
                 _data.set(offset++, TWO);
                 break;
             default:
-                std::cerr << "Error reading input data - exiting =(\n";
-                exit(1);
+                throw std::runtime_error("Error reading input data =(!\n");
         } ++col_idx;
     }
     return offset;
@@ -430,38 +1120,37 @@ void Block<Elements, ThreadsX, ThreadsY>::process_snps()
                         col_info.set_type(NIH);
                     }
                     
-                    // If there atre more 1's than 0's flip all the bits
-                    //if (col_info.ones() > col_info.zeros() && !col_info.is_monotone()) 
-                    //    flip_column_bits(col_idx, col_info.start_index(), col_info.end_index());
-                    
                     // If the column is splittable, add it to the splittable info 
                     if (splittable && !col_info.is_monotone()) _splittable_cols.push_back(col_idx);
                 }
             }
         }
     );
+    // Columns with more 1's than 0's are flipped (lazily) when normalising
+    set_flip_mask();
+
     // Need to sort the splittable columns in ascending order
     sort_splittable_cols();
 }
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
-void Block<Elements, ThreadsX, ThreadsY>::flip_column_bits(const size_t col_idx       , 
-                                                           const size_t col_start_row ,
-                                                           const size_t col_end_row   )
+void Block<Elements, ThreadsX, ThreadsY>::set_flip_mask()
 {
-    for (size_t row_idx = col_start_row; row_idx <= col_end_row; ++row_idx) {
-        size_t mem_offset    = _read_info[row_idx].offset() + col_idx - _read_info[row_idx].start_index(); 
-        auto   element_value = _data.get(mem_offset);
-        
-        // Check that the element is not a gap, then set it
-        if (element_value <= ONE) {                             
-            element_value == ZERO 
-                ? _data.set(mem_offset, ONE)
-                : _data.set(mem_offset, ZERO);
+    constexpr size_t bin_size = mask_vector::elements_per_bin;
+    _flip_mask.resize(_cols);
+
+    // Each bin is set by one thread, so no two threads write to the same bin
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _cols / bin_size + 1),
+        [&](const tbb::blocked_range<size_t>& bins)
+        {
+            for (size_t col_idx = bins.begin() * bin_size; col_idx < std::min(bins.end() * bin_size, _cols);
+                 ++col_idx) {
+                const auto& col_info = _snp_info[col_idx];
+                _flip_mask.set(col_idx, col_info.ones() > col_info.zeros() && !col_info.is_monotone());
+            }
         }
-    }
-    // Add that this column was flipped
-    _flipped_cols[col_idx] = 0;
+    );
 }
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
@@ -477,6 +1166,94 @@ void Block<Elements, ThreadsX, ThreadsY>::sort_splittable_cols()
     // Check that the last column is in the vector (just some error checking incase)
     if (_splittable_cols[_splittable_cols.size() - 1] != _cols - 1) 
         _splittable_cols.push_back(_cols - 1);
+
+    // Now that the subblocks are known, find the ones which can be solved directly
+    find_trivial_subblocks();
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::find_trivial_subblocks()
+{
+    // The last splittable column only ends a subblock
+    const size_t subblocks = num_subblocks() > 0 ? num_subblocks() - 1 : 0;
+    index_container cols(subblocks, 0);
+    _trivial.assign(num_subblocks(), false);
+    _trivial_reads.assign(num_subblocks(), index_container());
+    _shapes.assign(num_subblocks(), SubBlockShape());
+    _components.assign(num_subblocks(), index_container());
+
+    for (size_t i = 0; i < subblocks; ++i) {
+        for (size_t col_idx = subblock(i); col_idx <= subblock(i + 1); ++col_idx)
+            if (!is_monotone(col_idx)) ++cols[i];
+        _shapes[i].snps = cols[i];
+    }
+
+    // Find the subblock of each non singular read (which is the same rule as SubBlock::fill)
+    const auto first = _splittable_cols.begin() + _first_splittable;
+    const auto last  = _splittable_cols.begin() + _first_splittable + subblocks;
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        const auto& read_info = _read_info[row_idx];
+        if (read_info.length() <= 1) continue;
+
+        const auto next = std::upper_bound(first, last, read_info.start_index());
+        if (next == first) continue;
+        const size_t i = (next - first) - 1;
+        if (read_info.end_index() <= subblock(i + 1)) {
+            _trivial_reads[i].push_back(row_idx);
+            ++_shapes[i].reads;
+            _shapes[i].elements += read_info.length();
+        }
+    }
+
+    for (size_t i = 0; i < subblocks; ++i)
+        _trivial[i] = cols[i] <= TRIVIAL_MAX_COLS || _trivial_reads[i].size() <= TRIVIAL_MAX_READS;
+
+    // The reads of the subblocks which aren't trivial are only kept to find their components
+    tbb::parallel_for(size_t(0), subblocks, [&](const size_t i)
+    {
+        if (_trivial[i]) return;
+        find_components(i, _trivial_reads[i]);
+        index_container().swap(_trivial_reads[i]);
+    });
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::find_components(const size_t i, const index_container& reads)
+{
+    // The index of each column of the subblock in the non monotone columns
+    const size_t    start_col = subblock(i), end_col = subblock(i + 1);
+    const size_t    snps      = _shapes[i].snps;
+    index_container snp_of(end_col - start_col + 1, 0);
+    for (size_t col_idx = start_col, snp_idx = 0; col_idx <= end_col; ++col_idx) {
+        snp_of[col_idx - start_col] = snp_idx;
+        if (!is_monotone(col_idx)) ++snp_idx;
+    }
+
+    // Each read links the columns it has a value in
+    UnionFind         sets(snps);
+    std::vector<bool> observed(snps, false);
+    for (const auto row_idx : reads) {
+        const auto& read_info = _read_info[row_idx];
+        size_t      previous  = UnionFind::none;
+        _sparse.for_each_value(row_idx, read_info.start_index(), read_info.end_index(),
+            [&](const size_t col_idx) { return operator()(row_idx, col_idx); },
+            [&](const size_t col_idx, const uint8_t)
+            {
+                if (is_monotone(col_idx)) return;
+                const size_t snp_idx = snp_of[col_idx - start_col];
+                if (previous != UnionFind::none) sets.join(previous, snp_idx);
+                observed[snp_idx] = true;
+                previous          = snp_idx;
+            }
+        );
+    }
+    for (size_t snp_idx = 1; snp_idx < snps; ++snp_idx) {
+        if (!observed[snp_idx]) sets.join(snp_idx - 1, snp_idx);
+    }
+    if (snps > 1 && !observed[0]) sets.join(0, 1);
+
+    _shapes[i].components = std::max(sets.sets(), size_t(1));
+    if (sets.sets() > 1) sets.labels(_components[i]);
 }
 
 
@@ -0,0 +1,255 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   checkpoint.hpp
+/// @brief  Header file for the checkpoint, which periodically saves the solved sub-blocks of a run to an
+///         append only file, so that a run which is stopped can be resumed without solving them again
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_CHECKPOINT_HPP
+#define PARAHAPLO_CHECKPOINT_HPP
+
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifndef CHECKPOINT_INTERVAL
+    #define CHECKPOINT_INTERVAL     30.0    // Seconds between writing the solved sub-blocks to the file
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Checkpoint
+/// @brief      An append only file of the solved sub-blocks of a block. The file starts with a magic word,
+///             a fingerprint of the block (its reads and elements, and how it was split) and the columns
+///             the block was split at, followed by a record of 64 bit words for each solved sub-block: its
+///             index, its number of snps and the bits of its two haplotypes. Records are appended as the
+///             sub-blocks are solved, and written to the file at most every interval, so that the cost
+///             of checkpointing a run with many small sub-blocks is small. When a checkpoint is opened for
+///             a block it is checked against the block -- a checkpoint for different input, or a different
+///             split, is discarded -- and a record which was only partly written is removed. A file which
+///             is not a checkpoint is never overwritten.
+// ----------------------------------------------------------------------------------------------------------
+class Checkpoint {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using word_type         = uint64_t;
+    using word_container    = std::vector<word_type>;
+    using binary_vector     = BinaryVector<2>;
+    using clock_type        = std::chrono::steady_clock;
+    using time_point        = clock_type::time_point;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr word_type  magic = 0x3130545048434850ULL;    // "PHCHPT01"
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Entry
+    /// @brief      A sub-block solution from the checkpoint file
+    // ------------------------------------------------------------------------------------------------------
+    struct Entry {
+        size_t          index;          //!< The index of the sub-block
+        binary_vector   haplo_one;      //!< The first haplotype of the sub-block
+        binary_vector   haplo_two;      //!< The second haplotype of the sub-block
+    };
+
+    using entry_container   = std::vector<Entry>;
+private:
+    std::string         _filename;      //!< The name of the checkpoint file
+    double              _interval;      //!< The seconds between writes of the records to the file
+    std::ofstream       _file;          //!< The file the records are appended to
+    word_container      _buffer;        //!< The records which have not been written to the file
+    entry_container     _resumed;       //!< The solutions in the file when it was opened
+    size_t              _written;       //!< The number of records appended since the file was opened
+    time_point          _last_write;    //!< When the records were last written to the file
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- the file is only read when it is opened for a block
+    /// @param[in]  filename    The name of the checkpoint file
+    /// @param[in]  interval    The most seconds between writes of the solved sub-blocks to the file
+    // ------------------------------------------------------------------------------------------------------
+    explicit Checkpoint(const std::string& filename, const double interval = CHECKPOINT_INTERVAL)
+    : _filename(filename), _interval(interval), _written(0), _last_write(clock_type::now()) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- writes any buffered records
+    // ------------------------------------------------------------------------------------------------------
+    ~Checkpoint() { flush(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the fingerprint of a block -- its size, the span and elements of each read,
+    ///             and the columns it was split at
+    /// @param[in]  block       The (parsed and split) block
+    /// @tparam     BlockType   The type of the block
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BlockType>
+    static word_type fingerprint(const BlockType& block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Opens the checkpoint for a block -- loads the solutions in the file if it is a checkpoint
+    ///             of the block, otherwise starts a new checkpoint. Throws a runtime_error if the file is
+    ///             not empty and is not a checkpoint
+    /// @param[in]  block       The (parsed and split) block
+    /// @tparam     BlockType   The type of the block
+    /// @return     The number of solutions which were loaded
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BlockType>
+    size_t open(const BlockType& block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds the solution of a sub-block, which is written to the file when the interval since
+    ///             the last write has passed -- not safe to call concurrently
+    /// @param[in]  index       The index of the sub-block
+    /// @param[in]  haplo_one   The first haplotype of the sub-block
+    /// @param[in]  haplo_two   The second haplotype of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void append(const size_t index, const binary_vector& haplo_one, const binary_vector& haplo_two);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the buffered records to the file
+    // ------------------------------------------------------------------------------------------------------
+    void flush();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the solutions which were in the file when it was opened
+    // ------------------------------------------------------------------------------------------------------
+    inline entry_container& resumed() { return _resumed; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of solutions added since the file was opened
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t written() const { return _written; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of words of the haplotype bits of a record
+    /// @param[in]  snps    The number of snps of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t haplo_words(const size_t snps) { return 2 * ((snps + 63) / 64); }
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename BlockType>
+Checkpoint::word_type Checkpoint::fingerprint(const BlockType& block)
+{
+    const size_t subblocks = block.num_subblocks();
+    word_type    key       = ResultCache::combine(block.reads(), block.haplo_one().size());
+    key = ResultCache::combine(key, subblocks);
+    for (size_t i = 0; i < subblocks; ++i) key = ResultCache::combine(key, block.subblock(i));
+
+    for (size_t read_idx = 0; read_idx < block.reads(); ++read_idx) {
+        const auto& read = block.read_info(read_idx);
+        const word_type span = (static_cast<word_type>(read.start_index()) << 32) | read.end_index();
+        key = ResultCache::combine(key, span);
+
+        word_type    elements = 0;
+        const size_t end_idx  = std::min(read.end_index() + 1, block.haplo_one().size());
+        for (size_t col_idx = read.start_index(); col_idx < end_idx; ++col_idx) {
+            elements = (elements << 2) | (block(read_idx, col_idx) & 0x03);
+            if ((col_idx - read.start_index()) % 32 == 31) {
+                key      = ResultCache::combine(key, elements);
+                elements = 0;
+            }
+        }
+        key = ResultCache::combine(key, elements);
+    }
+    return key;
+}
+
+template <typename BlockType>
+size_t Checkpoint::open(const BlockType& block)
+{
+    const size_t   subblocks = block.num_subblocks() > 0 ? block.num_subblocks() - 1 : 0;
+    word_container header{ magic, fingerprint(block), block.num_subblocks() };
+    for (size_t i = 0; i < block.num_subblocks(); ++i) header.push_back(block.subblock(i));
+
+    if (_file.is_open()) _file.close();
+    _buffer.clear(); _resumed.clear();
+    _written = 0;
+
+    // Read the whole file -- the records are small next to the block
+    word_container  words;
+    std::streamoff  bytes = 0;
+    {
+        std::ifstream input(_filename, std::ios::binary | std::ios::ate);
+        if (input) {
+            bytes = input.tellg();
+            words.resize(static_cast<size_t>(bytes) / sizeof(word_type));
+            input.seekg(0);
+            input.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(word_type));
+        }
+    }
+
+    // Only a checkpoint (of another block) is discarded, any other file is left alone
+    if (bytes > 0 && (words.empty() || words[0] != magic))
+        throw std::runtime_error("File " + _filename + " is not a checkpoint =(!\n");
+
+    const bool valid = words.size() >= header.size() &&
+                       std::equal(header.begin(), header.end(), words.begin());
+    size_t     end   = header.size();
+    for (size_t word = end; valid && word + 2 <= words.size(); word = end) {
+        const size_t index = words[word], snps = words[word + 1];
+        if (index >= subblocks || snps != block.subblock_shape(index).snps) break;
+        if (word + 2 + haplo_words(snps) > words.size()) break;
+
+        Entry entry{ index, binary_vector(snps), binary_vector(snps) };
+        const word_type* bits = words.data() + word + 2;
+        for (size_t i = 0; i < snps; ++i) {
+            entry.haplo_one.set(i, (bits[i / 64] >> (i % 64)) & 1);
+            entry.haplo_two.set(i, (bits[(snps + 63) / 64 + i / 64] >> (i % 64)) & 1);
+        }
+        _resumed.push_back(std::move(entry));
+        end = word + 2 + haplo_words(snps);
+    }
+
+    if (valid) {
+        // Remove a partly written record, so that the next record follows the last complete one
+        if (end < words.size() && truncate(_filename.c_str(), end * sizeof(word_type)) != 0) end = 0;
+    }
+    if (valid && end > 0) {
+        _file.open(_filename, std::ios::binary | std::ios::app);
+    } else {
+        _resumed.clear();
+        _file.open(_filename, std::ios::binary | std::ios::trunc);
+        _file.write(reinterpret_cast<const char*>(header.data()), header.size() * sizeof(word_type));
+        _file.flush();
+    }
+    _last_write = clock_type::now();
+    return _resumed.size();
+}
+
+inline void Checkpoint::append(const size_t         index    , const binary_vector& haplo_one,
+                               const binary_vector& haplo_two)
+{
+    const size_t snps  = haplo_one.size();
+    const size_t start = _buffer.size();
+    _buffer.resize(start + 2 + haplo_words(snps), 0);
+    _buffer[start] = index; _buffer[start + 1] = snps;
+
+    word_type* bits = _buffer.data() + start + 2;
+    for (size_t i = 0; i < snps; ++i) {
+        bits[i / 64]                    |= static_cast<word_type>(haplo_one.get(i) & 1) << (i % 64);
+        bits[(snps + 63) / 64 + i / 64] |= static_cast<word_type>(haplo_two.get(i) & 1) << (i % 64);
+    }
+    ++_written;
+
+    if (std::chrono::duration<double>(clock_type::now() - _last_write).count() >= _interval) flush();
+}
+
+inline void Checkpoint::flush()
+{
+    if (_file.is_open() && !_buffer.empty()) {
+        _file.write(reinterpret_cast<const char*>(_buffer.data()), _buffer.size() * sizeof(word_type));
+        _file.flush();
+        _buffer.clear();
+    }
+    _last_write = clock_type::now();
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_CHECKPOINT_HPP
@@ -0,0 +1,361 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   dispatcher.hpp
+/// @brief  Header file for the solver dispatcher, which profiles each sub-block and uses a cost model to
+///         choose the solver for it
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_DISPATCHER_HPP
+#define PARAHAPLO_DISPATCHER_HPP
+
+#include "exact_solver.hpp"
+#include "graph_cpu.hpp"
+#include "multilevel.hpp"
+#include "result_cache.hpp"
+
+#include <tbb/concurrent_vector.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace haplo {
+namespace solver {
+
+static constexpr uint8_t trivial        = 0;        // Closed form for a single read or a single snp
+static constexpr uint8_t exact          = 1;        // Dynamic programming over the columns
+static constexpr uint8_t graph          = 2;        // Heuristic graph search
+static constexpr uint8_t multi_start    = 3;        // Heuristic graph search from multiple starts
+static constexpr uint8_t multilevel     = 4;        // Coarsen, partition and refine for large sub-blocks
+
+static constexpr const char* names[5] = { "trivial", "exact", "graph", "multi-start", "multilevel" };
+
+}               // End namespace solver
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     SubBlockProfile
+/// @brief      The shape of a sub-block, from which the cost of each solver is estimated
+// ----------------------------------------------------------------------------------------------------------
+struct SubBlockProfile {
+    size_t  reads;                  //!< The number of reads
+    size_t  snps;                   //!< The number of snps
+    size_t  coverage;               //!< The largest number of reads spanning a snp
+    size_t  nih_columns;            //!< The number of NIH columns
+    size_t  element_spans;          //!< The sum of the read lengths
+    double  duplicate_ratio;        //!< The fraction of the reads which duplicate another read
+    double  exact_states;           //!< The bipartitions the exact solver enumerates (sum of 2^coverage)
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     CostModel
+/// @brief      Coefficients of the cost model of the solvers. The costs of the solvers were measured on the
+///             input files of the tests (with -O2), and can be recalibrated for a machine by timing the
+///             solvers and setting the coefficients
+// ----------------------------------------------------------------------------------------------------------
+struct CostModel {
+    double  exact_ns_per_state      = 60.0;     //!< Time for the exact solver per enumerated bipartition
+    double  exact_fixed_ns          = 5e3;      //!< Time to set up the exact solver
+    double  graph_ns_per_overlap    = 30.0;     //!< Time for the graph search per read element and overlap
+    double  graph_fixed_ns          = 5e4;      //!< Time to set up the graph search
+    double  exact_preference        = 4.0;      //!< How much slower the exact solver may be and be chosen
+    double  multi_start_budget_ns   = 5e6;      //!< Largest graph cost for which multiple starts are used
+    double  multi_start_nih_ratio   = 0.25;     //!< Smallest fraction of NIH columns for multiple starts
+    double  multi_start_max_dups    = 0.5;      //!< Largest duplicate ratio for multiple starts
+    double  multilevel_ns_overlap   = 5.0;      //!< Time for the multilevel solver per element and overlap
+    size_t  multilevel_min_reads    = 10000;    //!< Fewest reads for which the multilevel solver is used
+    size_t  exact_max_coverage      = EXACT_MAX_COVERAGE;   //!< Largest coverage for the exact solver
+    size_t  starts                  = 4;        //!< The number of starts for the multi-start search
+    size_t  max_neighbours          = 0;        //!< Edges kept per read by the graph search (0 for all)
+    size_t  edge_budget             = 0;        //!< Most bytes of edges the graph search holds in memory
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     DispatchRecord
+/// @brief      A log entry for the dispatch of a sub-block to a solver
+// ----------------------------------------------------------------------------------------------------------
+struct DispatchRecord {
+    size_t          index;          //!< The index of the sub-block
+    SubBlockProfile profile;        //!< The profile of the sub-block
+    uint8_t         choice;         //!< The solver which was chosen (see solver::)
+    double          estimate_ns;    //!< The estimated time for the chosen solver
+    double          elapsed_ns;     //!< The time the solver took
+    size_t          mec_score;      //!< The MEC score of the solution
+    bool            cached;         //!< If the solution was found in the result cache
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Dispatcher
+/// @brief      Profiles sub-blocks, chooses the solver which the cost model predicts to be best for each,
+///             solves them, and logs the choices. Sub-blocks which the exact solver can do in not much
+///             more time than the graph search are solved exactly, since the solution is then optimal.
+///             Graph searches which are cheap, for sub-blocks with many NIH columns (where the initial
+///             partition is least constrained) and few duplicate reads, use multiple starts. Dispatching
+///             is thread safe, so sub-blocks can be solved in parallel. With a result cache, sub-blocks
+///             which were solved (with the same settings) in an earlier run take their solution from it.
+/// @tparam     SubBlockType    The type of the sub-blocks to solve
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class Dispatcher {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using exact_solver_type             = ExactSolver<SubBlockType>;
+    using graph_type                    = Graph<SubBlockType, devices::cpu>;
+    using multilevel_solver_type        = MultilevelSolver<SubBlockType>;
+    using log_container                 = tbb::concurrent_vector<DispatchRecord>;
+    using clock_type                    = std::chrono::steady_clock;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    CostModel           _model;             //!< The cost model for choosing the solvers
+    log_container       _log;               //!< The record of each dispatch
+    std::ostream*       _log_stream;        //!< Stream to print each dispatch to (nullptr for none)
+    ResultCache*        _cache;             //!< The cache of solved sub-blocks (nullptr for none)
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  model       The cost model for choosing the solvers
+    /// @param[in]  log_stream  The stream to print each dispatch to, nullptr to only record them
+    // ------------------------------------------------------------------------------------------------------
+    explicit Dispatcher(const CostModel& model = CostModel(), std::ostream* log_stream = nullptr)
+    : _model(model), _log_stream(log_stream), _cache(nullptr) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the profile of a sub-block
+    /// @param[in]  sub_block   The sub-block to profile
+    // ------------------------------------------------------------------------------------------------------
+    static SubBlockProfile profile(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Chooses the solver for a sub-block
+    /// @param[in]  profile     The profile of the sub-block
+    /// @param[out] estimate_ns The estimated time of the chosen solver
+    /// @return     The solver (see solver::)
+    // ------------------------------------------------------------------------------------------------------
+    uint8_t choose(const SubBlockProfile& profile, double& estimate_ns) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Profiles a sub-block, solves it with the chosen solver and logs the dispatch
+    /// @param[in]  sub_block   The sub-block to solve
+    /// @return     The MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    size_t solve(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the record of the dispatches
+    // ------------------------------------------------------------------------------------------------------
+    inline const log_container& log() const { return _log; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the cost model
+    // ------------------------------------------------------------------------------------------------------
+    inline const CostModel& model() const { return _model; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the cache of solved sub-blocks
+    /// @param[in]  cache   The cache to look the sub-blocks up in and add them to (nullptr for none)
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_cache(ResultCache* cache) { _cache = cache; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the key of the settings of a solver, which are combined with the content of a
+    ///             sub-block for its key in the result cache
+    /// @param[in]  choice  The solver (see solver::)
+    // ------------------------------------------------------------------------------------------------------
+    ResultCache::key_type settings_key(const uint8_t choice) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints a dispatch record
+    /// @param[in]  stream  The stream to print to
+    /// @param[in]  record  The record to print
+    // ------------------------------------------------------------------------------------------------------
+    static void print_record(std::ostream& stream, const DispatchRecord& record);
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a sub-block which has a single read or a single snp -- the first haplotype is the
+    ///             read (or all zeros), and the second is its complement, which has an MEC score of zero
+    /// @param[in]  sub_block   The sub-block to solve
+    // ------------------------------------------------------------------------------------------------------
+    void solve_trivial(SubBlockType& sub_block) const;
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename SubBlockType>
+SubBlockProfile Dispatcher<SubBlockType>::profile(SubBlockType& sub_block)
+{
+    const auto&     read_info = sub_block.read_info();
+    const size_t    snps      = sub_block.snp_info().size();
+    SubBlockProfile profile;
+
+    profile.reads           = sub_block.reads();
+    profile.snps            = snps;
+    profile.nih_columns     = sub_block.nih_columns();
+    profile.duplicate_ratio = profile.reads > 0
+                            ? static_cast<double>(sub_block.duplicate_rows()) / profile.reads : 0.0;
+
+    // The coverage of each snp from the starts and ends of the reads
+    std::vector<int64_t> changes(snps + 1, 0);
+    profile.element_spans = 0;
+    for (size_t read_idx = 0; read_idx < profile.reads; ++read_idx) {
+        ++changes[read_info[read_idx].start_index()];
+        --changes[read_info[read_idx].end_index() + 1];
+        profile.element_spans += read_info[read_idx].length();
+    }
+
+    int64_t coverage = 0;
+    profile.coverage     = 0;
+    profile.exact_states = 0.0;
+    for (size_t snp_idx = 0; snp_idx < snps; ++snp_idx) {
+        coverage             += changes[snp_idx];
+        profile.coverage      = std::max(profile.coverage, static_cast<size_t>(coverage));
+        profile.exact_states += std::ldexp(1.0, static_cast<int>(coverage));
+    }
+    return profile;
+}
+
+template <typename SubBlockType>
+uint8_t Dispatcher<SubBlockType>::choose(const SubBlockProfile& profile, double& estimate_ns) const
+{
+    if (profile.reads <= 1 || profile.snps <= 1) {
+        estimate_ns = static_cast<double>(profile.snps);
+        return solver::trivial;
+    }
+
+    // Each element of a read is compared with the elements of the overlapping reads
+    const double graph_ns = _model.graph_fixed_ns + _model.graph_ns_per_overlap * profile.element_spans
+                                                                                 * profile.coverage;
+    const double exact_ns = _model.exact_fixed_ns + _model.exact_ns_per_state   * profile.exact_states;
+
+    if (profile.coverage <= _model.exact_max_coverage && exact_ns <= _model.exact_preference * graph_ns) {
+        estimate_ns = exact_ns;
+        return solver::exact;
+    }
+
+    // The graph search compares every pair of overlapping reads, which is too slow for many reads
+    if (profile.reads >= _model.multilevel_min_reads) {
+        estimate_ns = _model.multilevel_ns_overlap * profile.element_spans * profile.coverage;
+        return solver::multilevel;
+    }
+
+    estimate_ns = graph_ns;
+    const double nih_ratio = static_cast<double>(profile.nih_columns) / profile.snps;
+    if (_model.starts > 1                                       &&
+        graph_ns                <= _model.multi_start_budget_ns &&
+        nih_ratio               >= _model.multi_start_nih_ratio &&
+        profile.duplicate_ratio <= _model.multi_start_max_dups  ) {
+        return solver::multi_start;
+    }
+    return solver::graph;
+}
+
+template <typename SubBlockType>
+size_t Dispatcher<SubBlockType>::solve(SubBlockType& sub_block)
+{
+    DispatchRecord record;
+    record.index     = sub_block.index();
+    record.profile   = profile(sub_block);
+    record.choice    = choose(record.profile, record.estimate_ns);
+    record.mec_score = 0;
+    record.cached    = false;
+
+    // Trivial sub-blocks are quicker to solve than to look up
+    const auto start = clock_type::now();
+    ResultCache::key_type key = 0;
+    if (_cache != nullptr && record.choice != solver::trivial) {
+        key = ResultCache::combine(ResultCache::content_key(sub_block), settings_key(record.choice));
+        record.cached = _cache->find(key, record.profile.snps, record.profile.reads,
+                                     sub_block._haplo_one, sub_block._haplo_two, record.mec_score);
+    }
+
+    if (!record.cached) switch (record.choice) {
+        case solver::trivial: {
+            solve_trivial(sub_block);
+            break;
+        }
+        case solver::exact: {
+            exact_solver_type exact_solver(sub_block, _model.exact_max_coverage);
+            exact_solver.search();
+            record.mec_score = exact_solver.mec_score();
+            break;
+        }
+        case solver::multilevel: {
+            multilevel_solver_type multilevel_solver(sub_block);
+            multilevel_solver.search();
+            record.mec_score = multilevel_solver.mec_score();
+            break;
+        }
+        default: {
+            graph_type graph(sub_block, refine::fm, record.choice == solver::multi_start ? _model.starts : 1,
+                             record.index);
+            graph.set_max_neighbours(_model.max_neighbours);
+            graph.set_edge_budget(_model.edge_budget);
+            graph.search();
+            record.mec_score = graph.mec_score();
+            break;
+        }
+    }
+    if (_cache != nullptr && record.choice != solver::trivial && !record.cached) {
+        _cache->insert(key, record.profile.reads, sub_block._haplo_one, sub_block._haplo_two,
+                       record.mec_score);
+    }
+    record.elapsed_ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+
+    _log.push_back(record);
+    if (_log_stream != nullptr) print_record(*_log_stream, record);
+    return record.mec_score;
+}
+
+template <typename SubBlockType>
+ResultCache::key_type Dispatcher<SubBlockType>::settings_key(const uint8_t choice) const
+{
+    // The seed of the graph search (the index of the sub-block) is left out, so that a solution can be
+    // found again after the sub-blocks before it change
+    ResultCache::key_type key = ResultCache::mix(choice);
+    switch (choice) {
+        case solver::exact:
+            return ResultCache::combine(key, _model.exact_max_coverage);
+        case solver::multilevel:
+            return key;
+        default:
+            key = ResultCache::combine(key, choice == solver::multi_start ? _model.starts : 1);
+            key = ResultCache::combine(key, _model.max_neighbours);
+            return ResultCache::combine(key, _model.edge_budget);
+    }
+}
+
+template <typename SubBlockType>
+void Dispatcher<SubBlockType>::print_record(std::ostream& stream, const DispatchRecord& record)
+{
+    std::ostringstream line;
+    line << "SUB-BLOCK "    << record.index
+         << " : reads "     << record.profile.reads
+         << " snps "        << record.profile.snps
+         << " coverage "    << record.profile.coverage
+         << " nih "         << record.profile.nih_columns
+         << " dups "        << std::fixed << std::setprecision(2) << record.profile.duplicate_ratio
+         << " -> "          << solver::names[record.choice]
+         << " (estimate "   << std::setprecision(3) << record.estimate_ns / 1e6 << "ms"
+         << ", took "       << record.elapsed_ns / 1e6 << "ms"
+         << ", mec "        << record.mec_score << (record.cached ? ", cached" : "") << ")\n";
+    stream << line.str();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+void Dispatcher<SubBlockType>::solve_trivial(SubBlockType& sub_block) const
+{
+    const size_t snps = sub_block.snp_info().size();
+    for (size_t snp_idx = 0; snp_idx < snps; ++snp_idx) {
+        const uint8_t element = sub_block.reads() == 1 ? sub_block(0, snp_idx) : 0;
+        const uint8_t value   = element <= 1 ? element : 0;
+        sub_block._haplo_one.set(snp_idx, value);
+        sub_block._haplo_two.set(snp_idx, !value);
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_DISPATCHER_HPP
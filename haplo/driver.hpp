@@ -0,0 +1,418 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   driver.hpp
+/// @brief  Header file for the driver, which phases all the sub-blocks of a block as a pipeline of stages
+///         on a tbb flow graph
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_DRIVER_HPP
+#define PARAHAPLO_DRIVER_HPP
+
+#include "checkpoint.hpp"
+#include "dispatcher.hpp"
+#include "region_writer.hpp"
+#include "scheduler.hpp"
+
+#include <tbb/tbb.h>
+#include <tbb/flow_graph.h>
+#include <tbb/spin_mutex.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef DRIVER_BUILD_CONCURRENCY
+    #define DRIVER_BUILD_CONCURRENCY    2       // Sub-blocks which are built at the same time
+#endif
+#ifndef DRIVER_IN_FLIGHT_FACTOR
+    #define DRIVER_IN_FLIGHT_FACTOR     2       // Sub-blocks in flight for each concurrent solve (default)
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Driver
+/// @brief      Phases a block, as a pipeline of stages on a flow graph -- the sub-blocks are built, solved
+///             (with the solver chosen by the dispatcher) and collected, with bounded concurrency in each
+///             stage, so that building the next sub-blocks overlaps solving the current ones. The sub-blocks
+///             enter the pipeline as the tasks of a Scheduler (largest first by default), and the tasks run
+///             on the work stealing task scheduler of tbb. A batched task of small sub-blocks builds and
+///             solves them one at a time in the solve stage. Each
+///             sub-block is a copy of the block, so the number in flight is bounded by only feeding the
+///             next sub-block to the pipeline when one has been collected. The block is not modified
+///             while sub-blocks are built from it: the solutions, and those of the trivial sub-blocks,
+///             are staged once the pipeline has finished, and then merged in parallel. With a checkpoint,
+///             each solved sub-block is saved as it is collected, and the sub-blocks which a stopped run
+///             saved are collected from the checkpoint rather than solved again. A sub-block whose columns
+///             fall into independent components (no read links them) is solved a component at a time, each
+///             as a sub-block of its own size, and the haplotypes of the components are put back together.
+/// @tparam     BlockType       The type of the block to phase
+/// @tparam     SubBlockType    The type of the sub-blocks of the block
+// ----------------------------------------------------------------------------------------------------------
+template <typename BlockType, typename SubBlockType>
+class Driver {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using block_type                    = BlockType;
+    using sub_block_type                = SubBlockType;
+    using dispatcher_type               = Dispatcher<SubBlockType>;
+    using writer_type                   = RegionWriter<BlockType>;
+    using binary_vector                 = BinaryVector<2>;
+    using index_container               = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Solution
+    /// @brief      The haplotypes of a solved sub-block
+    // ------------------------------------------------------------------------------------------------------
+    struct Solution {
+        size_t                          index;          //!< The index of the sub-block
+        binary_vector                   haplo_one;      //!< The first haplotype of the solution
+        binary_vector                   haplo_two;      //!< The second haplotype of the solution
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Job
+    /// @brief      A task (one sub-block, or a batch of small ones) as it moves through the pipeline
+    // ------------------------------------------------------------------------------------------------------
+    struct Job {
+        const index_container*          indices;        //!< The indices of the sub-blocks of the task
+        std::shared_ptr<sub_block_type> sub_block;      //!< The built sub-block (of a task of one)
+        std::vector<Solution>           solutions;      //!< The solutions of the sub-blocks
+        double                          elapsed_ns;     //!< The time spent building and solving
+    };
+
+    using job_type                      = std::shared_ptr<Job>;
+    using solution_container            = std::vector<Solution>;
+    using collect_function              = std::function<void(Solution&&)>;
+    using clock_type                    = std::chrono::high_resolution_clock;
+
+    size_t              _build_concurrency;     //!< The most sub-blocks built at once
+    size_t              _solve_concurrency;     //!< The most sub-blocks solved at once
+    size_t              _max_in_flight;         //!< The most sub-blocks between building and collection
+    size_t              _live;                  //!< The sub-blocks which currently exist
+    size_t              _peak_live;             //!< The most sub-blocks which existed at once
+    tbb::spin_mutex     _live_mutex;            //!< Protects the counts of the sub-blocks
+    uint8_t             _order;                 //!< The order of the sub-blocks (see schedule::)
+    ScheduleReport      _report;                //!< How close the last run was to the ideal makespan
+    Checkpoint*         _checkpoint;            //!< Saves the solved sub-blocks (nullptr for none)
+    size_t              _resumed;               //!< The sub-blocks of the last run taken from the checkpoint
+    bool                _split_components;      //!< If the components of the sub-blocks are solved apart
+    dispatcher_type     _dispatcher;            //!< Chooses the solver for each sub-block
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  model               The cost model for choosing the solvers
+    /// @param[in]  solve_concurrency   The most sub-blocks solved at once, 0 for the number of cores
+    /// @param[in]  build_concurrency   The most sub-blocks built at once
+    /// @param[in]  max_in_flight       The most sub-blocks in the pipeline at once (each is a copy of the
+    ///             block), 0 for DRIVER_IN_FLIGHT_FACTOR per concurrent solve
+    // ------------------------------------------------------------------------------------------------------
+    explicit Driver(const CostModel& model             = CostModel()             ,
+                    const size_t     solve_concurrency = 0                       ,
+                    const size_t     build_concurrency = DRIVER_BUILD_CONCURRENCY,
+                    const size_t     max_in_flight     = 0                       );
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Phases the block -- solves all of its sub-blocks and merges the haplotypes
+    /// @param[in]  block   The (parsed and split) block to phase
+    // ------------------------------------------------------------------------------------------------------
+    void run(block_type& block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Phases the block, streaming each region to the writer as soon as it and all the regions
+    ///             before it are solved, and releasing the solution once written. The haplotypes are not
+    ///             merged into the block
+    /// @param[in]  block   The (parsed and split) block to phase
+    /// @param[in]  writer  The writer for the regions of the block
+    // ------------------------------------------------------------------------------------------------------
+    void run(const block_type& block, writer_type& writer);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the dispatcher, which has the record of the solver used for each sub-block
+    // ------------------------------------------------------------------------------------------------------
+    inline const dispatcher_type& dispatcher() const { return _dispatcher; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most sub-blocks which existed at once in the last run
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t peak_sub_blocks() const { return _peak_live; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most sub-blocks which are in the pipeline at once
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_in_flight() const { return _max_in_flight; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the order which the sub-blocks enter the pipeline in
+    /// @param[in]  order   The order of the sub-blocks (see schedule::)
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_order(const uint8_t order) { _order = order; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets if the independent components of a sub-block are solved separately (the default), or
+    ///             the sub-block is solved as a whole
+    /// @param[in]  split   If the components are solved separately
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_split_components(const bool split) { _split_components = split; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the cache of solved sub-blocks, so that sub-blocks solved in an earlier run aren't
+    ///             solved again
+    /// @param[in]  cache   The cache to look the sub-blocks up in (nullptr for none)
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_cache(ResultCache* cache) { _dispatcher.set_cache(cache); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the checkpoint, which is opened for the block at the start of each run, so that a
+    ///             stopped run can be resumed
+    /// @param[in]  checkpoint  The checkpoint of the solved sub-blocks (nullptr for none)
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_checkpoint(Checkpoint* checkpoint) { _checkpoint = checkpoint; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of sub-blocks in the last run which were taken from the checkpoint
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t resumed() const { return _resumed; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the report of how close the last run was to the ideal makespan
+    // ------------------------------------------------------------------------------------------------------
+    inline const ScheduleReport& report() const { return _report; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Runs the non trivial sub-blocks of the block through the pipeline
+    /// @param[in]  block   The block to phase, which is not modified while the pipeline runs
+    /// @param[in]  collect The function which takes each solved sub-block, called serially
+    // ------------------------------------------------------------------------------------------------------
+    void pipeline(const block_type& block, const collect_function& collect);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Builds a sub-block, and counts it as live
+    /// @param[in]  block   The block to build the sub-block from
+    /// @param[in]  i       The index of the sub-block
+    /// @param[in]  component   The component of the sub-block to build (component::all for all of it)
+    // ------------------------------------------------------------------------------------------------------
+    std::shared_ptr<sub_block_type> build(const block_type& block, const size_t i,
+                                          const size_t      component = component::all);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if a sub-block is solved a component at a time
+    /// @param[in]  block   The block of the sub-block
+    /// @param[in]  i       The index of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    inline bool split(const block_type& block, const size_t i) const
+    {
+        return _split_components && block.subblock_shape(i).components > 1;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a sub-block, keeps its haplotypes and frees it
+    /// @param[in]  index       The index of the sub-block
+    /// @param[in]  sub_block   The sub-block to solve, which is reset
+    /// @param[out] solutions   The solutions to add the solution of the sub-block to
+    // ------------------------------------------------------------------------------------------------------
+    void solve(const size_t index, std::shared_ptr<sub_block_type>& sub_block, solution_container& solutions);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Builds and solves a sub-block -- a component at a time if it is split, putting the
+    ///             haplotypes of each component back in the columns of the component
+    /// @param[in]  block       The block of the sub-block
+    /// @param[in]  index       The index of the sub-block
+    /// @param[out] solutions   The solutions to add the solution of the sub-block to
+    // ------------------------------------------------------------------------------------------------------
+    void solve(const block_type& block, const size_t index, solution_container& solutions);
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename BlockType, typename SubBlockType>
+Driver<BlockType, SubBlockType>::Driver(const CostModel& model            , const size_t solve_concurrency,
+                                        const size_t     build_concurrency, const size_t max_in_flight    )
+: _build_concurrency(std::max(build_concurrency, size_t(1)))                                          ,
+  _solve_concurrency(solve_concurrency > 0 ? solve_concurrency : std::thread::hardware_concurrency()) ,
+  _max_in_flight(max_in_flight)                                                                        ,
+  _live(0), _peak_live(0), _order(schedule::largest_first), _checkpoint(nullptr), _resumed(0)           ,
+  _split_components(true)                                                                              ,
+  _dispatcher(model)
+{
+    // The number of cores is 0 if it can't be determined
+    _solve_concurrency = std::max(_solve_concurrency, size_t(1));
+    if (_max_in_flight == 0) _max_in_flight = DRIVER_IN_FLIGHT_FACTOR * _solve_concurrency;
+}
+
+template <typename BlockType, typename SubBlockType>
+void Driver<BlockType, SubBlockType>::run(block_type& block)
+{
+    const size_t       subblocks = block.num_subblocks() > 0 ? block.num_subblocks() - 1 : 0;
+    solution_container solved(subblocks);
+    pipeline(block, [&](Solution&& solution) { solved[solution.index] = std::move(solution); });
+
+    // Nothing else uses the block now, so stage the solutions and merge them all at once
+    tbb::parallel_for(size_t(0), subblocks, [&](const size_t i)
+    {
+        if (!block.stage_trivial(i)) block.stage_solution(i, solved[i].haplo_one, solved[i].haplo_two);
+    });
+    block.merge_haplotypes();
+}
+
+template <typename BlockType, typename SubBlockType>
+void Driver<BlockType, SubBlockType>::run(const block_type& block, writer_type& writer)
+{
+    pipeline(block, [&](Solution&& solution)
+    {
+        writer.push(solution.index, block.staged_solution(solution.haplo_one, solution.haplo_two));
+    });
+    writer.flush();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename BlockType, typename SubBlockType>
+void Driver<BlockType, SubBlockType>::pipeline(const block_type& block, const collect_function& collect)
+{
+    // The sub-blocks saved by a stopped run are collected first, and not scheduled
+    const size_t      subblocks = block.num_subblocks() > 0 ? block.num_subblocks() - 1 : 0;
+    std::vector<bool> finished(subblocks, false);
+    _resumed = 0;
+    if (_checkpoint != nullptr) {
+        _resumed = _checkpoint->open(block);
+        for (auto& entry : _checkpoint->resumed()) {
+            if (finished[entry.index]) continue;
+            finished[entry.index] = true;
+            collect(Solution{entry.index, std::move(entry.haplo_one), std::move(entry.haplo_two)});
+        }
+        _checkpoint->resumed().clear();
+    }
+
+    const Scheduler scheduler(block, _order, SCHEDULER_BATCH_COST, SCHEDULER_BATCH_SIZE, &finished);
+    const auto&     tasks = scheduler.tasks();
+
+    tbb::flow::graph graph;
+    size_t           next = 0;
+    _live = _peak_live = 0;
+    _report = ScheduleReport();
+    _report.tasks   = tasks.size();
+    _report.workers = _solve_concurrency;
+    for (const auto& task : tasks) _report.batched += task.size() > 1 ? task.size() : 0;
+
+    // Build the sub-block of a task of one -- each is a copy of the block with its reads
+    tbb::flow::function_node<size_t, job_type> builder(graph, _build_concurrency,
+        [&](const size_t t)
+        {
+            const auto start = clock_type::now();
+            job_type   job   = std::make_shared<Job>();
+            job->indices = &tasks[t];
+            const size_t i = job->indices->front();
+            if (job->indices->size() == 1 && !split(block, i)) job->sub_block = build(block, i);
+            job->elapsed_ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+            return job;
+        }
+    );
+
+    // Solve the sub-blocks, keeping only the haplotypes so that the sub-blocks can be freed -- a batch (or
+    // a split sub-block) is built and solved one sub-block at a time, so it only has one copy of the block
+    tbb::flow::function_node<job_type, job_type> solver(graph, _solve_concurrency,
+        [&](job_type job)
+        {
+            const auto start = clock_type::now();
+            if (job->sub_block) {
+                solve(job->indices->front(), job->sub_block, job->solutions);
+            } else {
+                for (const auto i : *job->indices) solve(block, i, job->solutions);
+            }
+            job->elapsed_ns += std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+            return job;
+        }
+    );
+
+    // Collect the solutions, and let the next task into the pipeline (serial, so no atomics)
+    tbb::flow::function_node<job_type, tbb::flow::continue_msg> collector(graph, tbb::flow::serial,
+        [&](job_type job)
+        {
+            for (auto& solution : job->solutions) {
+                if (_checkpoint != nullptr)
+                    _checkpoint->append(solution.index, solution.haplo_one, solution.haplo_two);
+                collect(std::move(solution));
+            }
+            _report.work_ns    += job->elapsed_ns;
+            _report.longest_ns  = std::max(_report.longest_ns, job->elapsed_ns);
+            if (next < tasks.size()) builder.try_put(next++);
+            return tbb::flow::continue_msg();
+        }
+    );
+
+    tbb::flow::make_edge(builder, solver);
+    tbb::flow::make_edge(solver, collector);
+
+    // The next task is set before any task can be collected
+    const auto start = clock_type::now();
+    next = std::min(_max_in_flight, tasks.size());
+    for (size_t t = 0; t < next; ++t) builder.try_put(t);
+    graph.wait_for_all();
+    if (_checkpoint != nullptr) _checkpoint->flush();
+    _report.makespan_ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+}
+
+template <typename BlockType, typename SubBlockType>
+std::shared_ptr<SubBlockType> Driver<BlockType, SubBlockType>::build(const block_type& block,
+                                                                     const size_t      i    ,
+                                                                     const size_t      component)
+{
+    auto sub_block = std::make_shared<sub_block_type>(block, i, component);
+
+    tbb::spin_mutex::scoped_lock lock(_live_mutex);
+    _peak_live = std::max(_peak_live, ++_live);
+    return sub_block;
+}
+
+template <typename BlockType, typename SubBlockType>
+void Driver<BlockType, SubBlockType>::solve(const size_t                     index    ,
+                                            std::shared_ptr<sub_block_type>& sub_block,
+                                            solution_container&              solutions)
+{
+    _dispatcher.solve(*sub_block);
+    solutions.push_back(Solution{index, sub_block->haplo_one(), sub_block->haplo_two()});
+    sub_block.reset();
+
+    tbb::spin_mutex::scoped_lock lock(_live_mutex);
+    --_live;
+}
+
+template <typename BlockType, typename SubBlockType>
+void Driver<BlockType, SubBlockType>::solve(const block_type&   block    , const size_t index,
+                                            solution_container& solutions)
+{
+    if (!split(block, index)) {
+        auto sub_block = build(block, index);
+        solve(index, sub_block, solutions);
+        return;
+    }
+
+    // The columns of each component, in order
+    const auto&                  components = block.column_components(index);
+    std::vector<index_container> columns(block.subblock_shape(index).components);
+    for (size_t snp_idx = 0; snp_idx < components.size(); ++snp_idx)
+        columns[components[snp_idx]].push_back(snp_idx);
+
+    // Each component is phased independently, so its haplotypes go straight into its columns
+    Solution           solution{index, binary_vector(components.size()), binary_vector(components.size())};
+    solution_container parts;
+    for (size_t component = 0; component < columns.size(); ++component) {
+        auto sub_block = build(block, index, component);
+        solve(index, sub_block, parts);
+        const auto& part = parts.back();
+        for (size_t snp_idx = 0; snp_idx < columns[component].size(); ++snp_idx) {
+            solution.haplo_one.set(columns[component][snp_idx], part.haplo_one.get(snp_idx));
+            solution.haplo_two.set(columns[component][snp_idx], part.haplo_two.get(snp_idx));
+        }
+        parts.clear();
+    }
+    solutions.push_back(std::move(solution));
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_DRIVER_HPP
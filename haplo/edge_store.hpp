@@ -0,0 +1,223 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   edge_store.hpp
+/// @brief  Header file for the edge store class, which holds the edges of a graph within a memory budget by
+///         spilling sorted runs of edges to a temporary file and merging the runs when they are read
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_EDGE_STORE_HPP
+#define PARAHAPLO_EDGE_STORE_HPP
+
+#include "packed_edge.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+#include <tbb/parallel_sort.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifndef EDGE_STORE_TEMPLATE
+    #define EDGE_STORE_TEMPLATE "/tmp/parahaplo_edges_XXXXXX"   // Template for the temporary file name
+#endif
+
+namespace haplo {
+
+namespace io = boost::iostreams;
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      EdgeStore
+/// @brief      Stores the edges of a graph. Edges are added (concurrently) to an in memory buffer, and when
+///             the buffer exceeds the memory budget it is sorted and appended to a temporary file as a run.
+///             Once all the edges have been added they are visited in sorted order -- directly from the
+///             buffer if nothing was spilled, otherwise by a k-way merge of the memory mapped runs.
+// ----------------------------------------------------------------------------------------------------------
+class EdgeStore {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using edge_type             = PackedEdge;
+    using edge_container        = tbb::concurrent_vector<edge_type>;
+    using offset_container      = std::vector<size_t>;
+private:
+    size_t              _budget;            //!< The most bytes of edges to keep in memory (0 for no limit)
+    size_t              _size;              //!< The total number of edges (in memory and spilled)
+    edge_container      _buffer;            //!< The edges which are in memory
+    offset_container    _runs;              //!< The offset (in edges) of each run in the file, and the end
+    std::string         _filename;          //!< The name of the temporary file (empty if none)
+    std::ofstream       _file;              //!< The temporary file the runs are written to
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  budget  The most bytes of edges to keep in memory, 0 to keep all the edges in memory
+    // ------------------------------------------------------------------------------------------------------
+    explicit EdgeStore(const size_t budget = 0) noexcept : _budget(budget), _size(0), _runs(1, 0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- removes the temporary file
+    // ------------------------------------------------------------------------------------------------------
+    ~EdgeStore();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the memory budget
+    /// @param[in]  budget  The most bytes of edges to keep in memory, 0 to keep all the edges in memory
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_budget(const size_t budget) { _budget = budget; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the memory budget (in bytes, 0 is no limit)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t budget() const { return _budget; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds an edge -- safe to call concurrently, but not with spill()
+    /// @param[in]  edge    The edge to add
+    // ------------------------------------------------------------------------------------------------------
+    inline void push_back(const edge_type& edge) { _buffer.push_back(edge); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the total number of edges
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _size + _buffer.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of runs which have been spilled to the file
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t runs() const { return _runs.size() - 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If the edges in memory exceed the budget
+    // ------------------------------------------------------------------------------------------------------
+    inline bool over_budget() const { return _budget > 0 && _buffer.size() * sizeof(edge_type) > _budget; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sorts the edges in memory and appends them to the file as a run, if over the budget
+    // ------------------------------------------------------------------------------------------------------
+    void spill_if_over_budget() { if (over_budget()) spill(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sorts the edges -- the edges in memory are sorted, and if any runs have been spilled the
+    ///             remaining edges are spilled too, so that all the edges are merged from the file
+    // ------------------------------------------------------------------------------------------------------
+    void sort();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Visits the edges in sorted order (after sort())
+    /// @param[in]  visit   The function to call with each edge
+    // ------------------------------------------------------------------------------------------------------
+    void for_each(const std::function<void(const edge_type&)>& visit) const;
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sorts the edges in memory and appends them to the file as a run
+    // ------------------------------------------------------------------------------------------------------
+    void spill();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Reads the runs which were spilled back into memory and removes the file, so that all the
+    ///             edges are kept in memory from then on (when the file can't be written)
+    // ------------------------------------------------------------------------------------------------------
+    void unspill();
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline EdgeStore::~EdgeStore()
+{
+    if (_file.is_open()) _file.close();
+    if (!_filename.empty()) std::remove(_filename.c_str());
+}
+
+inline void EdgeStore::sort()
+{
+    if (runs() > 0) {
+        if (!_buffer.empty()) spill();
+        _file.flush();
+    } else {
+        tbb::parallel_sort(_buffer.begin(), _buffer.end());
+    }
+}
+
+inline void EdgeStore::for_each(const std::function<void(const edge_type&)>& visit) const
+{
+    if (runs() == 0) {
+        for (const auto& edge : _buffer) visit(edge);
+        return;
+    }
+
+    io::mapped_file_source file(_filename);
+    const edge_type*       edges = reinterpret_cast<const edge_type*>(file.data());
+
+    // Merge the runs, taking the smallest next edge of any run each time
+    using head_type = std::pair<edge_type::key_type, size_t>;
+    offset_container cursors(_runs.begin(), _runs.end() - 1);
+    std::priority_queue<head_type, std::vector<head_type>, std::greater<head_type>> heads;
+    for (size_t run = 0; run < runs(); ++run) {
+        if (cursors[run] < _runs[run + 1]) heads.emplace(edges[cursors[run]].key(), run);
+    }
+
+    while (!heads.empty()) {
+        const size_t run = heads.top().second;
+        heads.pop();
+        visit(edges[cursors[run]]);
+        if (++cursors[run] < _runs[run + 1]) heads.emplace(edges[cursors[run]].key(), run);
+    }
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline void EdgeStore::spill()
+{
+    if (!_file.is_open()) {
+        char filename[] = EDGE_STORE_TEMPLATE;
+        const int fd    = mkstemp(filename);
+        if (fd == -1) {
+            // Without a file the edges just stay in memory
+            std::cerr << "Error : Could not create a temporary file for the edges =(\n";
+            _budget = 0;
+            return;
+        }
+        close(fd);
+        _filename = filename;
+        _file.open(_filename, std::ios::binary | std::ios::trunc);
+    }
+
+    tbb::parallel_sort(_buffer.begin(), _buffer.end());
+    for (const auto& edge : _buffer)
+        _file.write(reinterpret_cast<const char*>(&edge), sizeof(edge_type));
+    _file.flush();
+
+    if (!_file) {
+        // The run is incomplete, so the merge can't read it -- keep all the edges in memory instead
+        std::cerr << "Error : Could not write the edges to the temporary file =(\n";
+        unspill();
+        return;
+    }
+
+    _size += _buffer.size();
+    _runs.push_back(_size);
+    _buffer.clear();
+}
+
+inline void EdgeStore::unspill()
+{
+    _file.close();
+    if (_size > 0) {
+        io::mapped_file_source file(_filename);
+        const edge_type*       edges = reinterpret_cast<const edge_type*>(file.data());
+        _buffer.grow_by(edges, edges + _size);
+    }
+    std::remove(_filename.c_str());
+    _filename.clear();
+    _size   = 0;
+    _budget = 0;
+    _runs.assign(1, 0);
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_EDGE_STORE_HPP
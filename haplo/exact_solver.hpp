@@ -0,0 +1,362 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   exact_solver.hpp
+/// @brief  Header file for the exact solver, which finds the minimum MEC haplotypes of a sub-block with
+///         dynamic programming over the columns, for sub-blocks with a low coverage
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_EXACT_SOLVER_HPP
+#define PARAHAPLO_EXACT_SOLVER_HPP
+
+#include "data.h"
+#include "partition.hpp"
+
+#include <tbb/tbb.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#ifndef EXACT_MAX_COVERAGE
+    #define EXACT_MAX_COVERAGE  16      // Largest coverage (active reads in a column) solved exactly
+#endif
+#ifndef EXACT_GRAIN_SIZE
+    #define EXACT_GRAIN_SIZE    1024    // Bipartitions enumerated by each task
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ExactSolver
+/// @brief      Finds the minimum MEC bipartition of the reads of a sub-block. The columns are swept left to
+///             right, and for each column the cost of every bipartition of the active reads (those whose
+///             span covers the column) is found, given the best bipartition of the previous column which
+///             agrees on the reads in both. Each column is O(2^coverage) -- the bipartitions are enumerated
+///             in Gray code order so that each one differs from the last by a single read, and the counts
+///             for the column are updated in constant time.
+/// @tparam     SubBlockType    The type of the sub-block to solve
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class ExactSolver {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using data_type                     = Data;
+    using partition_type                = Partition;
+    using read_info_type                = typename data_type::read_info_type;
+    using read_info_container           = thrust::host_vector<read_info_type>;
+    using snp_info_type                 = typename data_type::snp_info_type;
+    using snp_info_container            = thrust::host_vector<snp_info_type>;
+    using small_type                    = typename data_type::small_type;
+    using small_container               = thrust::host_vector<small_type>;
+    using mask_type                     = uint32_t;
+    using index_container               = std::vector<size_t>;
+    using cost_container                = std::vector<size_t>;
+    using mask_container                = std::vector<mask_type>;
+    using active_container              = std::vector<index_container>;
+    using backtrack_container           = std::vector<mask_container>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t no_cost     = std::numeric_limits<size_t>::max();
+private:
+    SubBlockType&               _sub_block;
+    small_container             _data_cpu;              //!< The sub-block data, one element per byte
+    read_info_container&        _read_info;             //!< The information for each read
+    snp_info_container          _snp_info;              //!< The information for each snp
+    size_t                      _snps;                  //!< The number of snps in the sub-block
+    size_t                      _reads;                 //!< The number of reads in the sub-block
+    size_t                      _max_coverage;          //!< The largest coverage which will be solved
+    size_t                      _coverage;              //!< The largest number of active reads in a column
+    size_t                      _mec_score;             //!< The MEC score of the solution
+    active_container            _active;                //!< The active reads of each column
+    index_container             _carried;               //!< The number of reads carried from the last column
+    backtrack_container         _backtrack;             //!< Best previous bipartition for each carried one
+    data_type                   _data;                  //!< View of the data for the partition
+    partition_type              _partition;             //!< The optimal partition of the fragments
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the coverage of the sub-block, and the active reads of each column if
+    ///             it is small enough to solve
+    /// @param[in]  sub_block       The sub-block to find the haplotypes of
+    /// @param[in]  max_coverage    The largest coverage to solve exactly (at most 31)
+    // ------------------------------------------------------------------------------------------------------
+    explicit ExactSolver(SubBlockType& sub_block, const size_t max_coverage = EXACT_MAX_COVERAGE);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the optimal haplotypes and puts them in the sub-block
+    /// @return     False if the coverage of the sub-block is too large to solve exactly, in which case the
+    ///             sub-block is not modified
+    // ------------------------------------------------------------------------------------------------------
+    bool search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the largest number of active reads in any column
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t coverage() const { return _coverage; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if the coverage of the sub-block is small enough to solve exactly
+    // ------------------------------------------------------------------------------------------------------
+    inline bool solvable() const { return _coverage <= _max_coverage; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the partition of the fragments
+    // ------------------------------------------------------------------------------------------------------
+    inline const partition_type& partition() const { return _partition; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the view of the data which the partition operates on
+    // ------------------------------------------------------------------------------------------------------
+    data_type data_view();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of a read at a snp (0 | 1, or 2 | 3 if there is no information)
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type value(const size_t read_idx, const size_t snp_idx) const
+    {
+        const auto& read_info = _read_info[read_idx];
+        return read_info.element_exists(snp_idx)
+             ? _data_cpu[read_info.offset() + snp_idx - read_info.start_index()] : 3;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the best cost of the previous column for each bipartition of the reads which
+    ///             are carried into a column, and which previous bipartition gives it
+    /// @param[in]  snp_idx     The index of the column
+    /// @param[in]  prev_costs  The costs of the bipartitions of the previous column
+    /// @param[out] best_costs  The best cost for each bipartition of the carried reads
+    /// @return     The number of carried reads
+    // ------------------------------------------------------------------------------------------------------
+    size_t project(const size_t snp_idx, const cost_container& prev_costs, cost_container& best_costs);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the cost of each bipartition of the active reads of a column
+    /// @param[in]  snp_idx     The index of the column
+    /// @param[in]  carried     The number of reads carried from the previous column
+    /// @param[in]  best_costs  The best cost of the previous column for each bipartition of the carried reads
+    /// @param[out] costs       The cost of each bipartition of the active reads
+    // ------------------------------------------------------------------------------------------------------
+    void sweep(const size_t snp_idx, const size_t carried, const cost_container& best_costs,
+               cost_container& costs) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the cost of a column from the zeros and ones of each set
+    /// @param[in]  snp_idx     The index of the column
+    /// @param[in]  counts      The zeros and ones in set one, then in set two
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t column_cost(const size_t snp_idx, const size_t* counts) const
+    {
+        // IH columns must have complementary haplotypes (as for the partition)
+        return _snp_info[snp_idx].type() == IH
+             ? std::min(counts[1] + counts[2], counts[0] + counts[3])
+             : std::min(counts[0], counts[1]) + std::min(counts[2], counts[3]);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Assigns the reads to the sets of the optimal bipartition by following the backtrack
+    /// @param[in]  last_mask   The optimal bipartition of the last column
+    // ------------------------------------------------------------------------------------------------------
+    void assign_reads(mask_type last_mask);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the result of the haplotype to the sub block
+    // ------------------------------------------------------------------------------------------------------
+    void set_sub_block_haplotypes();
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+template <typename SubBlockType>
+constexpr size_t ExactSolver<SubBlockType>::no_cost;
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename SubBlockType>
+ExactSolver<SubBlockType>::ExactSolver(SubBlockType& sub_block, const size_t max_coverage)
+: _sub_block(sub_block)                             , _data_cpu(sub_block.data().to_binary_vector())  ,
+  _read_info(sub_block.read_info())                 , _snp_info(sub_block.snp_info())                 ,
+  _snps(_snp_info.size())                           , _reads(_read_info.size())                       ,
+  _max_coverage(std::min(max_coverage, size_t(31))) , _coverage(0)                                    ,
+  _mec_score(no_cost)                               , _active(_snp_info.size())                       ,
+  _carried(_snp_info.size(), 0)                     , _backtrack(_snp_info.size())                    ,
+  _data(data_view())                                , _partition(_data)
+{
+    // Count the reads which start and finish at each column in one pass, so that the coverage is known
+    // (and too large a sub-block is rejected) before the active reads are found
+    index_container offsets(_snps + 1, 0), finished(_snps + 1, 0);
+    for (size_t read_idx = 0; read_idx < _reads; ++read_idx) {
+        ++offsets[_read_info[read_idx].start_index() + 1];
+        ++finished[std::min(_read_info[read_idx].end_index() + 1, _snps)];
+    }
+    for (size_t snp_idx = 0, active = 0; snp_idx < _snps; ++snp_idx) {
+        active    += offsets[snp_idx + 1] - finished[snp_idx];
+        _coverage  = std::max(_coverage, active);
+        offsets[snp_idx + 1] += offsets[snp_idx];
+    }
+    if (!solvable()) return;
+
+    // Bucket the reads by their start column, in read order
+    index_container starts(_reads), next(offsets.begin(), offsets.end() - 1);
+    for (size_t read_idx = 0; read_idx < _reads; ++read_idx)
+        starts[next[_read_info[read_idx].start_index()]++] = read_idx;
+
+    // Reads which are carried from the previous column keep their order, and new reads are added after
+    for (size_t snp_idx = 0; snp_idx < _snps; ++snp_idx) {
+        if (snp_idx > 0) {
+            for (const auto read_idx : _active[snp_idx - 1])
+                if (_read_info[read_idx].end_index() >= snp_idx) _active[snp_idx].push_back(read_idx);
+            _carried[snp_idx] = _active[snp_idx].size();
+        }
+        _active[snp_idx].insert(_active[snp_idx].end(), starts.begin() + offsets[snp_idx],
+                                starts.begin() + offsets[snp_idx + 1]);
+    }
+}
+
+template <typename SubBlockType>
+bool ExactSolver<SubBlockType>::search()
+{
+    if (!solvable()) return false;
+
+    cost_container prev_costs(1, 0), best_costs, costs;
+    for (size_t snp_idx = 0; snp_idx < _snps; ++snp_idx) {
+        const size_t carried = project(snp_idx, prev_costs, best_costs);
+        sweep(snp_idx, carried, best_costs, costs);
+        std::swap(prev_costs, costs);
+    }
+
+    const auto best = std::min_element(prev_costs.begin(), prev_costs.end());
+    _mec_score      = *best;
+
+    assign_reads(static_cast<mask_type>(best - prev_costs.begin()));
+    set_sub_block_haplotypes();
+    return true;
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+typename ExactSolver<SubBlockType>::data_type ExactSolver<SubBlockType>::data_view()
+{
+    data_type data(_snps, _reads);
+    data.data      = _data_cpu.size()  > 0 ? thrust::raw_pointer_cast(&_data_cpu[0])  : nullptr;
+    data.read_info = _read_info.size() > 0 ? thrust::raw_pointer_cast(&_read_info[0]) : nullptr;
+    data.snp_info  = _snp_info.size()  > 0 ? thrust::raw_pointer_cast(&_snp_info[0])  : nullptr;
+    return data;
+}
+
+template <typename SubBlockType>
+size_t ExactSolver<SubBlockType>::project(const size_t          snp_idx   ,
+                                          const cost_container& prev_costs,
+                                          cost_container&       best_costs)
+{
+    const size_t carried = _carried[snp_idx];
+    best_costs.assign(size_t(1) << carried, no_cost);
+    _backtrack[snp_idx].assign(size_t(1) << carried, 0);
+    if (snp_idx == 0) {
+        best_costs[0] = prev_costs[0];
+        return carried;
+    }
+
+    // Positions of the carried and the finished reads in the bipartitions of the previous column
+    const auto&         prev_active = _active[snp_idx - 1];
+    std::vector<size_t> carried_bits, finished_bits;
+    for (size_t bit = 0; bit < prev_active.size(); ++bit) {
+        _read_info[prev_active[bit]].end_index() >= snp_idx ? carried_bits.push_back(bit)
+                                                            : finished_bits.push_back(bit);
+    }
+
+    // For each bipartition of the carried reads, minimize over the finished reads in Gray code order
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, best_costs.size(), EXACT_GRAIN_SIZE),
+        [&](const tbb::blocked_range<size_t>& masks)
+        {
+            for (size_t carried_mask = masks.begin(); carried_mask != masks.end(); ++carried_mask) {
+                mask_type prev_mask = 0;
+                for (size_t i = 0; i < carried_bits.size(); ++i)
+                    if ((carried_mask >> i) & 1) prev_mask |= mask_type(1) << carried_bits[i];
+
+                size_t    best_cost = prev_costs[prev_mask];
+                mask_type best_mask = prev_mask;
+                for (size_t it = 1; it < (size_t(1) << finished_bits.size()); ++it) {
+                    prev_mask ^= mask_type(1) << finished_bits[__builtin_ctzll(it)];
+                    if (prev_costs[prev_mask] < best_cost) {
+                        best_cost = prev_costs[prev_mask]; best_mask = prev_mask;
+                    }
+                }
+                best_costs[carried_mask]          = best_cost;
+                _backtrack[snp_idx][carried_mask] = best_mask;
+            }
+        }
+    );
+    return carried;
+}
+
+template <typename SubBlockType>
+void ExactSolver<SubBlockType>::sweep(const size_t          snp_idx   , const size_t    carried,
+                                      const cost_container& best_costs, cost_container& costs  ) const
+{
+    const auto&  active       = _active[snp_idx];
+    const size_t bipartitions = size_t(1) << active.size();
+    const size_t carried_mask = (size_t(1) << carried) - 1;
+
+    small_container values(active.size());
+    for (size_t bit = 0; bit < active.size(); ++bit) values[bit] = value(active[bit], snp_idx);
+
+    costs.resize(bipartitions);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, bipartitions, EXACT_GRAIN_SIZE),
+        [&](const tbb::blocked_range<size_t>& its)
+        {
+            // Counts for the first bipartition of the range -- a set bit puts the read in set two
+            size_t mask      = its.begin() ^ (its.begin() >> 1);
+            size_t counts[4] = {0, 0, 0, 0};
+            for (size_t bit = 0; bit < active.size(); ++bit)
+                if (values[bit] <= 1) ++counts[2 * ((mask >> bit) & 1) + values[bit]];
+
+            for (size_t it = its.begin(); it != its.end(); ++it) {
+                if (it != its.begin()) {
+                    const size_t bit = __builtin_ctzll(it);
+                    mask ^= size_t(1) << bit;
+                    if (values[bit] <= 1) {
+                        const size_t set = (mask >> bit) & 1;
+                        --counts[2 * (1 - set) + values[bit]];
+                        ++counts[2 * set       + values[bit]];
+                    }
+                }
+                const size_t prev_cost = best_costs[mask & carried_mask];
+                costs[mask] = prev_cost == no_cost ? no_cost : prev_cost + column_cost(snp_idx, counts);
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void ExactSolver<SubBlockType>::assign_reads(mask_type last_mask)
+{
+    std::vector<uint8_t> assigned(_reads, 0);
+    mask_type            mask = last_mask;
+
+    for (size_t snp_idx = _snps; snp_idx-- > 0; ) {
+        const auto& active = _active[snp_idx];
+        for (size_t bit = 0; bit < active.size(); ++bit) {
+            if (assigned[active[bit]]) continue;
+            assigned[active[bit]] = 1;
+            _partition.assign(active[bit], ((mask >> bit) & 1) + 1);
+        }
+        const size_t carried = _backtrack[snp_idx].size();
+        mask = _backtrack[snp_idx][mask & (carried - 1)];
+    }
+}
+
+template <typename SubBlockType>
+void ExactSolver<SubBlockType>::set_sub_block_haplotypes()
+{
+    for (size_t i = 0; i < _snps; ++i) {
+        _sub_block._haplo_one.set(i, _partition.haplo_one()[i]);
+        _sub_block._haplo_two.set(i, _partition.haplo_two()[i]);
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_EXACT_SOLVER_HPP
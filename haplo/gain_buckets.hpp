@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   gain_buckets.hpp
+/// @brief  Header file for the gain buckets container, which holds elements keyed by a bounded integer
+///         gain so that the element with the largest gain can be found in constant time
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_GAIN_BUCKETS_HPP
+#define PARAHAPLO_GAIN_BUCKETS_HPP
+
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      GainBuckets
+/// @brief      Bucket list of elements keyed by gain, in the style of Fiduccia-Mattheyses. Each bucket is a
+///             doubly linked list (stored in arrays indexed by the element), so inserting, removing and
+///             updating the gain of an element are O(1), and popping the element with the largest gain is
+///             amortized O(1). Elements with the same gain are popped last in, first out.
+// ----------------------------------------------------------------------------------------------------------
+class GainBuckets {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using gain_type         = int64_t;
+    using index_container   = std::vector<size_t>;
+    using gain_container    = std::vector<gain_type>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+private:
+    gain_type           _max_gain;          //!< The largest magnitude of a gain
+    index_container     _heads;             //!< The first element in each bucket
+    index_container     _next;              //!< The next element in the bucket of each element
+    index_container     _prev;              //!< The previous element in the bucket of each element
+    gain_container      _gains;             //!< The gain of each element
+    std::vector<bool>   _contained;         //!< If each element is in a bucket
+    size_t              _top;               //!< Upper bound on the highest non empty bucket
+    size_t              _size;              //!< The number of elements in the buckets
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- creates empty buckets
+    /// @param[in]  elements    The number of elements which can be stored (indices 0 to elements - 1)
+    /// @param[in]  max_gain    The largest magnitude of any gain which will be stored
+    // ------------------------------------------------------------------------------------------------------
+    GainBuckets(const size_t elements, const gain_type max_gain)
+    : _max_gain(max_gain), _heads(2 * max_gain + 1, size_t(none)), _next(elements, size_t(none)),
+      _prev(elements, size_t(none)), _gains(elements, 0), _contained(elements, false), _top(0), _size(0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of elements in the buckets
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _size; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if there are no elements in the buckets
+    // ------------------------------------------------------------------------------------------------------
+    inline bool empty() const { return _size == 0; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if an element is in the buckets
+    /// @param[in]  idx     The index of the element
+    // ------------------------------------------------------------------------------------------------------
+    inline bool contains(const size_t idx) const { return _contained[idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the gain of an element
+    /// @param[in]  idx     The index of the element
+    // ------------------------------------------------------------------------------------------------------
+    inline gain_type gain(const size_t idx) const { return _gains[idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds an element to the bucket for its gain
+    /// @param[in]  idx     The index of the element (must not be in the buckets)
+    /// @param[in]  gain    The gain of the element, in [-max_gain, max_gain]
+    // ------------------------------------------------------------------------------------------------------
+    inline void insert(const size_t idx, const gain_type gain)
+    {
+        const size_t bucket = static_cast<size_t>(gain + _max_gain);
+        _gains[idx] = gain; _contained[idx] = true; ++_size;
+        _prev[idx]  = none; _next[idx]      = _heads[bucket];
+        if (_heads[bucket] != none) _prev[_heads[bucket]] = idx;
+        _heads[bucket] = idx;
+        if (bucket > _top) _top = bucket;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes an element from its bucket
+    /// @param[in]  idx     The index of the element (must be in the buckets)
+    // ------------------------------------------------------------------------------------------------------
+    inline void remove(const size_t idx)
+    {
+        const size_t bucket = static_cast<size_t>(_gains[idx] + _max_gain);
+        if (_prev[idx] != none) _next[_prev[idx]] = _next[idx];
+        else                    _heads[bucket]    = _next[idx];
+        if (_next[idx] != none) _prev[_next[idx]] = _prev[idx];
+        _contained[idx] = false; --_size;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Changes the gain of an element which is in the buckets
+    /// @param[in]  idx     The index of the element
+    /// @param[in]  gain    The new gain of the element
+    // ------------------------------------------------------------------------------------------------------
+    inline void update(const size_t idx, const gain_type gain)
+    {
+        if (gain == _gains[idx]) return;
+        remove(idx); insert(idx, gain);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the element with the largest gain from the buckets
+    /// @return     The index of the element, or none if the buckets are empty
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t pop()
+    {
+        if (_size == 0) return none;
+        while (_heads[_top] == none) --_top;
+        const size_t idx = _heads[_top];
+        remove(idx);
+        return idx;
+    }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_GAIN_BUCKETS_HPP
@@ -6,6 +6,12 @@
 #define PARHAPLO_GRAPH_H
 
 namespace haplo {
+namespace refine {
+
+static constexpr uint8_t fm      = 0;          // Sequential Fiduccia-Mattheyses passes
+static constexpr uint8_t batched = 1;          // Rounds of conflict-free parallel moves, then fm passes
+
+}               // End namespace refine
     
 // ----------------------------------------------------------------------------------------------------------
 /// @class      Graph
@@ -0,0 +1,711 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   graph_cpu.hpp
+/// @brief  Header file for parahaplo graph class -- cpu implementation
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_GRAPH_CPU_HPP
+#define PARAHAPLO_GRAPH_CPU_HPP
+
+#include "data.h"
+#include "devices.hpp"
+#include "edge_store.hpp"
+#include "gain_buckets.hpp"
+#include "graph.h"
+#include "lower_bound.hpp"
+#include "operations.hpp"
+#include "packed_edge.hpp"
+#include "partition.hpp"
+#include "search_control.hpp"
+#include "sketch.hpp"
+#include "small_containers.h"
+
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/task_arena.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#ifndef PERTURB_RATIO
+    #define PERTURB_RATIO   4       // One in this many fragments are moved by a perturbation
+#endif
+#ifndef EDGE_CHUNK_FRAGS
+    #define EDGE_CHUNK_FRAGS 4096   // Fragments mapped between checks of the edge memory budget
+#endif
+
+namespace haplo {
+
+// Specialization for cpu
+template <typename SubBlockType>
+class Graph<SubBlockType, devices::cpu> {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using binary_vector                 = BinaryVector<2>;
+    using data_type                     = Data;
+    using partition_type                = Partition;
+    using delta_type                    = typename partition_type::delta_type;
+    using gain_buckets_type             = GainBuckets;
+    using gain_type                     = typename gain_buckets_type::gain_type;
+    using read_info_type                = typename data_type::read_info_type;
+    using read_info_container           = thrust::host_vector<read_info_type>;
+    using snp_info_type                 = typename data_type::snp_info_type;
+    using snp_info_container            = thrust::host_vector<snp_info_type>;
+    using small_type                    = typename data_type::small_type;
+    using small_container               = thrust::host_vector<small_type>;
+    using edge_store_type               = EdgeStore;
+    using edge_type                     = typename edge_store_type::edge_type;
+    using generator_type                = std::mt19937_64;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t THREADS     = SubBlockType::THREADS_X + SubBlockType::THREADS_Y;
+private:
+    SubBlockType&               _sub_block;
+    small_container             _data_cpu;              //!< The sub-block data, one element per byte
+    read_info_container&        _read_info;             //!< The information for each read
+    snp_info_container          _snp_info;              //!< The information for each snp
+    size_t                      _snps;                  //!< The number of snps in the sub-block
+    size_t                      _reads;                 //!< The number of reads in the sub-block
+    size_t                      _mec_score;             //!< The MEC score of the solution
+    gain_type                   _max_gain;              //!< Bound on the gain of moving a fragment
+    uint8_t                     _refinement;            //!< The type of refinement (see refine::)
+    size_t                      _starts;                //!< The number of independent searches
+    size_t                      _seed;                  //!< The seed for the perturbed searches
+    SearchControl               _control;               //!< When to stop refining the solution
+    uint8_t                     _stop_reason;           //!< Why the refinement stopped (see stop::)
+    size_t                      _max_neighbours;        //!< Most edges kept for each fragment (0 for all)
+    data_type                   _data;                  //!< View of the data for the partition
+    edge_store_type             _edges;                 //!< The (informative) edges of the graph
+    partition_type              _partition;             //!< The partition of the fragments
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  sub_block   The sub-block to find the haplotypes of
+    /// @param[in]  refinement  The type of refinement to use (see refine::)
+    /// @param[in]  starts      The number of independent searches -- the first refines the partition from
+    ///             the edges, and the others refine randomly perturbed copies of it
+    /// @param[in]  seed        The seed for the perturbations, so that the searches are reproducible
+    // ------------------------------------------------------------------------------------------------------
+    explicit Graph(SubBlockType& sub_block, const uint8_t refinement = refine::fm, const size_t starts = 1,
+                   const size_t seed = 0);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the graph for the haplotypes
+    // ------------------------------------------------------------------------------------------------------
+    void search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the control for the refinement, so that its limits can be set before searching
+    // ------------------------------------------------------------------------------------------------------
+    inline SearchControl& control() { return _control; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the reason that the refinement of the solution stopped (see stop::)
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t stop_reason() const { return _stop_reason; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the number of neighbours kept for each fragment -- rather than comparing every pair
+    ///             of overlapping fragments, the candidates are found with locality sensitive hashing and
+    ///             only the most informative are kept, which bounds the edges by reads x neighbours. Fewer
+    ///             neighbours is faster, more gives a better initial partition
+    /// @param[in]  max_neighbours  The number of neighbours of each fragment, 0 to use all the fragments
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_max_neighbours(const size_t max_neighbours) { _max_neighbours = max_neighbours; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of neighbours kept for each fragment (0 is all)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_neighbours() const { return _max_neighbours; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the memory budget for the edges -- beyond it the edges are spilled to a temporary
+    ///             file in sorted runs, which are merged when the partitions are created, so that large
+    ///             sub-blocks are slower rather than running out of memory
+    /// @param[in]  budget  The most bytes of edges to keep in memory, 0 for no limit
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_edge_budget(const size_t budget) { _edges.set_budget(budget); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the memory budget for the edges (in bytes, 0 is no limit)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t edge_budget() const { return _edges.budget(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of sorted runs of edges which were spilled to a file
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t edge_runs() const { return _edges.runs(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of informative edges in the graph
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t edges() const { return _edges.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the partition of the fragments
+    // ------------------------------------------------------------------------------------------------------
+    inline const partition_type& partition() const { return _partition; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    void print_mec() const { std::cout << "MEC SCORE : " << _mec_score << "\n"; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the view of the data which the partition operates on
+    // ------------------------------------------------------------------------------------------------------
+    data_type data_view();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the distance between each pair of overlapping fragments (the same distance
+    ///             as the gpu search_graph kernel), keeping only the informative edges. With a memory budget
+    ///             the fragments are mapped in chunks, and the edges are spilled after any chunk which
+    ///             takes them over the budget
+    // ------------------------------------------------------------------------------------------------------
+    void map_edges();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the candidate neighbours of each fragment from sketches of the fragments, and keeps
+    ///             the most informative (furthest from a distance of 1) overlapping ones as edges
+    // ------------------------------------------------------------------------------------------------------
+    void map_sparse_edges();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the distance between two fragments
+    /// @param[in]  frag_one    The index of the first fragment
+    /// @param[in]  frag_two    The index of the second fragment
+    /// @return     The distance, 1.0 if the fragments are uninformative with respect to each other
+    // ------------------------------------------------------------------------------------------------------
+    float distance(const size_t frag_one, const size_t frag_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sorts the edges so that the most confident (furthest from a distance of 1) are first,
+    ///             which is the ascending order of the packed keys
+    // ------------------------------------------------------------------------------------------------------
+    void sort_edges();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the initial partitions from the sorted edges -- fragments joined by an edge with a
+    ///             distance above 1 are put in opposite sets, and below 1 in the same set, unless the
+    ///             fragments are already related through more confident edges
+    // ------------------------------------------------------------------------------------------------------
+    void map_to_partitions();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds the fragments which have no informative edges to the set with the fewest conflicts
+    // ------------------------------------------------------------------------------------------------------
+    void add_unpartitioned();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Performs a Fiduccia-Mattheyses pass -- every fragment is moved once, always taking the
+    ///             move with the largest gain (even if negative), and then the moves after the best prefix
+    ///             of the pass are undone. Only the gains of fragments sharing a snp with a moved fragment
+    ///             are updated
+    /// @param[in]  partition   The partition to refine
+    /// @return     The MEC score before the refinement
+    // ------------------------------------------------------------------------------------------------------
+    size_t refine_solution(partition_type& partition) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Performs a round of parallel moves -- the gains of all fragments are found in parallel,
+    ///             and then the improving moves are taken greedily by gain, skipping any fragment whose span
+    ///             overlaps that of an already selected one, so that the selected moves are independent and
+    ///             can be applied as a batch
+    /// @param[in]  partition   The partition to refine
+    /// @return     The MEC score before the refinement
+    // ------------------------------------------------------------------------------------------------------
+    size_t refine_solution_batched(partition_type& partition) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Refines a partition with the type of refinement of the graph until it reaches a local
+    ///             optimum, and then restarts from perturbations of the best partition until the control
+    ///             stops the search. The partition is left as the best one found
+    /// @param[in]  partition   The partition to refine
+    /// @param[in]  generator   The generator for the perturbations
+    /// @return     The reason that the refinement stopped
+    // ------------------------------------------------------------------------------------------------------
+    uint8_t refine(partition_type& partition, generator_type& generator) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves a random subset of the fragments (one in PERTURB_RATIO on average)
+    /// @param[in]  partition   The partition to perturb
+    /// @param[in]  generator   The generator for the perturbation
+    // ------------------------------------------------------------------------------------------------------
+    void perturb(partition_type& partition, generator_type& generator) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Refines perturbed copies of the partition concurrently (in an arena with at most one
+    ///             thread per start) and keeps the one with the lowest MEC score -- ties are broken by the
+    ///             index of the start, so the result does not depend on the scheduling
+    // ------------------------------------------------------------------------------------------------------
+    void multi_start_search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the gain of moving each of the fragments, in parallel
+    /// @param[in]  partition   The partition to find the gains for
+    /// @param[out] gains       The gain of each fragment
+    // ------------------------------------------------------------------------------------------------------
+    void find_gains(const partition_type& partition, std::vector<gain_type>& gains) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the result of the haplotype to the sub block
+    // ------------------------------------------------------------------------------------------------------
+    void set_sub_block_haplotypes();
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+template <typename SubBlockType>
+Graph<SubBlockType, devices::cpu>::Graph(SubBlockType& sub_block, const uint8_t refinement,
+                                         const size_t starts, const size_t seed)
+: _sub_block(sub_block)                             , _data_cpu(sub_block.data().to_binary_vector())  ,
+  _read_info(sub_block.read_info())                 , _snp_info(sub_block.snp_info())                 ,
+  _snps(_snp_info.size())                           , _reads(_read_info.size())                       ,
+  _mec_score(std::numeric_limits<size_t>::max())    , _max_gain(0)                                    ,
+  _refinement(refinement)                           , _starts(std::max(starts, size_t(1)))            ,
+  _seed(seed)                                       , _stop_reason(stop::none)                        ,
+  _max_neighbours(0)                                , _data(data_view())                              ,
+  _partition(_data)
+{
+    // Moving a fragment changes the contribution of each of its snps by at most 2
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx)
+        _max_gain = std::max(_max_gain, static_cast<gain_type>(2 * _read_info[frag_idx].length()));
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::search()
+{
+    _control.start();                                   // The time budget covers the whole search
+
+    // The packed edges only have room for 24 bit fragment indices, beyond which the fragments are all
+    // partitioned greedily (this is far larger than any sub-block the solvers are used for)
+    if (_reads <= edge_type::max_fragments) {
+        if (_max_neighbours > 0) map_sparse_edges();    // Find the most informative edges
+        else                     map_edges();           // Find all the informative edges
+        sort_edges();                                   // Most confident edges first
+        map_to_partitions();                            // Create the partitions from the edges
+    }
+    add_unpartitioned();                                // Partition the fragments without edges
+
+    // Stop refining as soon as the solution is proven to be optimal
+    _control.set_lower_bound(LowerBound(_data).bound());
+
+    // Refine the solution
+    if (_starts > 1) {
+        multi_start_search();
+    } else {
+        generator_type generator(_seed);
+        _stop_reason = refine(_partition, generator);
+    }
+
+    _mec_score = _partition.mec_score();
+
+    // Put the haplotypes back into the sub_block
+    set_sub_block_haplotypes();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+typename Graph<SubBlockType, devices::cpu>::data_type Graph<SubBlockType, devices::cpu>::data_view()
+{
+    data_type data(_snps, _reads);
+    data.data      = _data_cpu.size()  > 0 ? thrust::raw_pointer_cast(&_data_cpu[0])  : nullptr;
+    data.read_info = _read_info.size() > 0 ? thrust::raw_pointer_cast(&_read_info[0]) : nullptr;
+    data.snp_info  = _snp_info.size()  > 0 ? thrust::raw_pointer_cast(&_snp_info[0])  : nullptr;
+    return data;
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_edges()
+{
+    // Order the fragments by start index so that the overlapping fragments of each one follow it
+    std::vector<size_t> order(_reads);
+    for (size_t i = 0; i < _reads; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
+    {
+        return _read_info[a].start_index() != _read_info[b].start_index()
+             ? _read_info[a].start_index()  < _read_info[b].start_index() : a < b;
+    });
+
+    const size_t chunk = _edges.budget() > 0 ? EDGE_CHUNK_FRAGS : _reads;
+
+    for (size_t first = 0; first < _reads; first += chunk) {
+        const size_t frags   = std::min(chunk, _reads - first);
+        const size_t threads = THREADS < frags ? THREADS : frags;
+
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, threads),
+            [&](const tbb::blocked_range<size_t>& thread_ids)
+            {
+                for (size_t thread_id = thread_ids.begin(); thread_id != thread_ids.end(); ++thread_id) {
+                    size_t thread_iters = ops::get_thread_iterations(thread_id, frags, threads);
+
+                    for (size_t it = 0; it < thread_iters; ++it) {
+                        const size_t idx      = first + ops::thread_map(thread_id, threads, it);
+                        const size_t frag_one = order[idx];
+
+                        for (size_t other = idx + 1; other < _reads; ++other) {
+                            const size_t frag_two = order[other];
+                            if (_read_info[frag_two].start_index() > _read_info[frag_one].end_index()) break;
+
+                            const float dist = distance(frag_one, frag_two);
+                            if (dist != 1.0f) {
+                                _edges.push_back(edge_type(dist, std::min(frag_one, frag_two),
+                                                                 std::max(frag_one, frag_two)));
+                            }
+                        }
+                    }
+                }
+            }
+        );
+        _edges.spill_if_over_budget();
+    }
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_sparse_edges()
+{
+    const FragmentSketches sketches(_data, _seed);
+    std::vector<std::vector<edge_type>> neighbours(_reads);
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _reads),
+        [&](const tbb::blocked_range<size_t>& frags)
+        {
+            std::vector<size_t> candidates;
+            for (size_t frag_one = frags.begin(); frag_one != frags.end(); ++frag_one) {
+                const auto& info_one = _read_info[frag_one];
+                auto&       edges    = neighbours[frag_one];
+
+                candidates.clear();
+                sketches.candidates(frag_one, candidates);
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+                for (const auto frag_two : candidates) {
+                    const auto& info_two = _read_info[frag_two];
+                    if (frag_two == frag_one || info_two.start_index() > info_one.end_index() ||
+                        info_one.start_index() > info_two.end_index()) continue;
+
+                    const float dist = distance(frag_one, frag_two);
+                    if (dist != 1.0f) edges.push_back(edge_type(dist, std::min(frag_one, frag_two),
+                                                                      std::max(frag_one, frag_two)));
+                }
+
+                // Keep the most informative neighbours (the keys order the most confident first)
+                if (edges.size() > _max_neighbours) {
+                    std::partial_sort(edges.begin(), edges.begin() + _max_neighbours, edges.end());
+                    edges.resize(_max_neighbours);
+                }
+            }
+        }
+    );
+
+    // An edge can be kept by both of its fragments, in which case both copies have the same key, so they
+    // are adjacent once sorted and only one is added
+    std::vector<edge_type> edges;
+    for (const auto& frag_edges : neighbours) edges.insert(edges.end(), frag_edges.begin(), frag_edges.end());
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (i == 0 || !edges[i].same_fragments(edges[i - 1])) _edges.push_back(edges[i]);
+    }
+}
+
+template <typename SubBlockType>
+float Graph<SubBlockType, devices::cpu>::distance(const size_t frag_one, const size_t frag_two) const
+{
+    const auto& info_one   = _read_info[frag_one];
+    const auto& info_two   = _read_info[frag_two];
+    const size_t start_snp = std::min(info_one.start_index(), info_two.start_index());
+    const size_t end_snp   = std::max(info_one.end_index()  , info_two.end_index()  );
+    size_t       distance  = 0, elements = 0;
+
+    for (size_t snp_idx = start_snp; snp_idx <= end_snp; ++snp_idx) {
+        const bool    one_valid = info_one.element_exists(snp_idx);
+        const bool    two_valid = info_two.element_exists(snp_idx);
+        const uint8_t value_one = one_valid ? _data_cpu[info_one.offset() + snp_idx - info_one.start_index()] : 3;
+        const uint8_t value_two = two_valid ? _data_cpu[info_two.offset() + snp_idx - info_two.start_index()] : 3;
+
+        if (value_one <= 1 && value_two <= 1) {
+            distance += value_one != value_two ? 10 : 0; ++elements;
+        } else if (value_one <= 1 || value_two <= 1) {
+            // Only one of the fragments has information for the snp
+            distance += 5; ++elements;
+        }
+    }
+    return elements > 0 ? static_cast<float>(distance / 10.f) / static_cast<float>(elements) + 0.5f : 1.0f;
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::sort_edges()
+{
+    // The packed keys order the edges, so the sort only compares integers
+    _edges.sort();
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_to_partitions()
+{
+    // Disjoint sets of fragments, where the parity of a fragment is if it is in
+    // the opposite set to its parent
+    std::vector<size_t>  parents(_reads), sizes(_reads, 1);
+    std::vector<uint8_t> parities(_reads, 0);
+    for (size_t i = 0; i < _reads; ++i) parents[i] = i;
+
+    auto find = [&](size_t frag_idx, uint8_t& parity)
+    {
+        parity = 0;
+        while (parents[frag_idx] != frag_idx) {
+            // Halve the path, keeping the parity relative to the new parent
+            const size_t parent = parents[frag_idx];
+            if (parents[parent] != parent) {
+                parities[frag_idx] ^= parities[parent];
+                parents[frag_idx]   = parents[parent];
+            }
+            parity   ^= parities[frag_idx];
+            frag_idx  = parents[frag_idx];
+        }
+        return frag_idx;
+    };
+
+    _edges.for_each([&](const edge_type& edge)
+    {
+        uint8_t parity_one, parity_two;
+        size_t  root_one = find(edge.f1(), parity_one);
+        size_t  root_two = find(edge.f2(), parity_two);
+        if (root_one == root_two) return;
+
+        if (sizes[root_one] < sizes[root_two]) std::swap(root_one, root_two);
+        parents[root_two]   = root_one;
+        parities[root_two]  = parity_one ^ parity_two ^ (edge.opposite() ? 1 : 0);
+        sizes[root_one]    += sizes[root_two];
+    });
+
+    // Group the fragments by component, and add the largest components first
+    std::vector<std::vector<size_t>> components(_reads);
+    std::vector<uint8_t>             frag_sets(_reads);
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx) {
+        uint8_t parity;
+        components[find(frag_idx, parity)].push_back(frag_idx);
+        frag_sets[frag_idx] = 1 + parity;
+    }
+    std::stable_sort(components.begin(), components.end(),
+        [](const std::vector<size_t>& a, const std::vector<size_t>& b) { return a.size() > b.size(); });
+
+    for (const auto& component : components) {
+        if (component.size() < 2) break;
+
+        for (const auto frag_idx : component) _partition.assign(frag_idx, frag_sets[frag_idx]);
+
+        // The orientation of a component relative to the others is free, so keep the better one
+        const size_t mec_before_flip = _partition.mec_score();
+        for (const auto frag_idx : component) _partition.move(frag_idx);
+        if (_partition.mec_score() >= mec_before_flip)
+            for (const auto frag_idx : component) _partition.move(frag_idx);
+    }
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::add_unpartitioned()
+{
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx) {
+        if (_partition.set(frag_idx) != partition_type::unassigned) continue;
+        _partition.conflicts(frag_idx, 1) <= _partition.conflicts(frag_idx, 2)
+            ? _partition.assign(frag_idx, 1)
+            : _partition.assign(frag_idx, 2);
+    }
+}
+
+template <typename SubBlockType>
+size_t Graph<SubBlockType, devices::cpu>::refine_solution(partition_type& partition) const
+{
+    const size_t mec_score_before = partition.mec_score();
+
+    // The initial gains are independent, so find them in parallel
+    std::vector<gain_type> gains(_reads);
+    find_gains(partition, gains);
+
+    gain_buckets_type buckets(_reads, _max_gain);
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx) buckets.insert(frag_idx, gains[frag_idx]);
+
+    std::vector<size_t> moves, updated(_reads, 0);
+    size_t              best_mec_score = mec_score_before, best_prefix = 0;
+    moves.reserve(_reads);
+
+    while (!buckets.empty()) {
+        const size_t frag_idx = buckets.pop();
+        partition.move(frag_idx);
+        moves.push_back(frag_idx);
+
+        if (partition.mec_score() < best_mec_score) {
+            best_mec_score = partition.mec_score();
+            best_prefix    = moves.size();
+        }
+
+        // Update the gains of the unmoved fragments which share a snp with the moved one (once each) -- only
+        // the counts of the snps which the moved fragment has values at changed
+        partition.for_each_value(frag_idx, [&](const size_t snp_idx, const uint8_t)
+        {
+            for (auto other = partition.snp_frags_begin(snp_idx); other != partition.snp_frags_end(snp_idx);
+                 ++other) {
+                if (!buckets.contains(*other) || updated[*other] == moves.size()) continue;
+                updated[*other] = moves.size();
+                buckets.update(*other, -partition.move_delta(*other));
+            }
+        });
+    }
+
+    // Roll back to the best prefix of the pass
+    for (size_t move_idx = moves.size(); move_idx > best_prefix; --move_idx)
+        partition.move(moves[move_idx - 1]);
+
+    return mec_score_before;
+}
+
+template <typename SubBlockType>
+uint8_t Graph<SubBlockType, devices::cpu>::refine(partition_type& partition, generator_type& generator) const
+{
+    partition_type best(partition);
+    size_t         iters = 0, stalled_iters = 0;
+    bool           batched = _refinement == refine::batched;
+    uint8_t        stop_reason;
+
+    while ((stop_reason = _control.check(iters, best.mec_score())) == stop::none) {
+        const size_t prev_mec_score = batched ? refine_solution_batched(partition)
+                                              : refine_solution(partition);
+        ++iters;
+
+        if (partition.mec_score() < best.mec_score()) {
+            best          = partition;
+            stalled_iters = 0;
+        }
+        if (partition.mec_score() < prev_mec_score) continue;
+
+        // Batched rounds have converged, polish with fm passes before counting this as a local optimum
+        if (batched) {
+            batched = false;
+            continue;
+        }
+        if (_control.converged(stalled_iters++)) {
+            stop_reason = stop::converged;
+            break;
+        }
+
+        // Restart from a perturbation of the best partition
+        partition = best;
+        perturb(partition, generator);
+        batched = _refinement == refine::batched;
+    }
+    partition = best;
+    return stop_reason;
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::perturb(partition_type& partition, generator_type& generator) const
+{
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx)
+        if (generator() % PERTURB_RATIO == 0) partition.move(frag_idx);
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::multi_start_search()
+{
+    std::vector<partition_type> partitions(_starts, _partition);
+    std::vector<uint8_t>        stop_reasons(_starts, stop::none);
+
+    const int       concurrency = tbb::this_task_arena::max_concurrency();
+    tbb::task_arena arena(static_cast<int>(std::min(_starts, static_cast<size_t>(concurrency))));
+    arena.execute([&]
+    {
+        tbb::parallel_for(size_t(0), _starts, [&](const size_t start)
+        {
+            // Each start has its own generator, so the perturbation does not depend on the scheduling
+            generator_type generator(_seed * _starts + start);
+            if (start > 0) perturb(partitions[start], generator);
+            stop_reasons[start] = refine(partitions[start], generator);
+        });
+    });
+
+    size_t best_start = 0;
+    for (size_t start = 1; start < _starts; ++start)
+        if (partitions[start].mec_score() < partitions[best_start].mec_score()) best_start = start;
+    _partition   = partitions[best_start];
+    _stop_reason = stop_reasons[best_start];
+}
+
+template <typename SubBlockType>
+size_t Graph<SubBlockType, devices::cpu>::refine_solution_batched(partition_type& partition) const
+{
+    const size_t mec_score_before = partition.mec_score();
+
+    std::vector<gain_type> gains(_reads);
+    find_gains(partition, gains);
+
+    std::vector<size_t> candidates;
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx)
+        if (gains[frag_idx] > 0) candidates.push_back(frag_idx);
+    std::sort(candidates.begin(), candidates.end(), [&](const size_t a, const size_t b)
+    {
+        return gains[a] != gains[b] ? gains[a] > gains[b] : a < b;
+    });
+
+    // Take the best moves whose spans do not overlap
+    std::vector<uint8_t> claimed(_snps, 0);
+    std::vector<size_t>  batch;
+    for (const auto frag_idx : candidates) {
+        const auto& read_info = _read_info[frag_idx];
+        bool        overlaps  = false;
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx)
+            overlaps = overlaps || claimed[snp_idx];
+        if (overlaps) continue;
+
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx)
+            claimed[snp_idx] = 1;
+        batch.push_back(frag_idx);
+    }
+
+    if (!batch.empty()) partition.move_batch(batch);
+
+    return mec_score_before;
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::find_gains(const partition_type& partition,
+                                                   std::vector<gain_type>& gains) const
+{
+    const size_t threads = THREADS < _reads ? THREADS : _reads;
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, threads),
+        [&](const tbb::blocked_range<size_t>& thread_ids)
+        {
+            for (size_t thread_id = thread_ids.begin(); thread_id != thread_ids.end(); ++thread_id) {
+                size_t thread_iters = ops::get_thread_iterations(thread_id, _reads, threads);
+
+                for (size_t it = 0; it < thread_iters; ++it) {
+                    const size_t frag_idx = ops::thread_map(thread_id, threads, it);
+                    gains[frag_idx] = -partition.move_delta(frag_idx);
+                }
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::set_sub_block_haplotypes()
+{
+    for (size_t i = 0; i < _snps; ++i) {
+        _sub_block._haplo_one.set(i, _partition.haplo_one()[i]);
+        _sub_block._haplo_two.set(i, _partition.haplo_two()[i]);
+    }
+}
+
+}           // End namespace haplo
+#endif      // PARAHAPLO_GRAPH_CPU_HPP
@@ -0,0 +1,235 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   lower_bound.hpp
+/// @brief  Header file for the lower bound class, which finds a lower bound on the MEC score of a sub-block
+///         from groups of fragments which cannot all be partitioned without an error
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_LOWER_BOUND_HPP
+#define PARAHAPLO_LOWER_BOUND_HPP
+
+#include "data.h"
+
+#include <tbb/tbb.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <algorithm>
+#include <vector>
+
+#ifndef NIH
+    #define IH  0x00
+    #define NIH 0x01
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      LowerBound
+/// @brief      A lower bound on the MEC score of a sub-block. Two fragments which differ at a snp must be in
+///             different sets, and two fragments which agree at an IH snp must be in the same set (since the
+///             haplotypes are complementary there), otherwise one of them has an error. A pair with both
+///             relations, or a triangle with an odd number of different relations, always has an error, so
+///             a set of such groups which share no fragments gives a bound of one error per group.
+// ----------------------------------------------------------------------------------------------------------
+class LowerBound {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using data_type             = Data;
+    using small_type            = uint8_t;
+    using small_container       = std::vector<small_type>;
+    using count_container       = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr small_type differ  = 0x01;     // The fragments have different values at a snp
+    static constexpr small_type agree   = 0x02;     // The fragments have the same value at an IH snp
+    static constexpr small_type seen    = 0x04;     // The fragments share a snp (only while mapping)
+private:
+    const data_type*    _data;              //!< The data for the sub-block
+    count_container     _snp_offsets;       //!< Offset of the fragments of each snp in _snp_frags
+    count_container     _snp_frags;         //!< The fragments with a value (0 | 1) at each snp
+    count_container     _offsets;           //!< Offset of the neighbours of each fragment
+    count_container     _neighbours;        //!< The fragments which share a snp with each fragment
+    small_container     _relations;         //!< The relation (differ | agree) to each neighbour
+    size_t              _pairs;             //!< The number of conflicting pairs in the bound
+    size_t              _triangles;         //!< The number of conflicting triangles in the bound
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the bound for the data
+    /// @param[in]  data    The data of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    explicit LowerBound(const data_type& data);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the lower bound on the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bound() const { return _pairs + _triangles; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragment pairs which both differ and agree (at an IH snp)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t pairs() const { return _pairs; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragment triangles with an odd number of different relations
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t triangles() const { return _triangles; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of a fragment at a snp which the fragment covers
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type value(const size_t frag_idx, const size_t snp_idx) const
+    {
+        const auto& read_info = _data->read_info[frag_idx];
+        return _data->data[read_info.offset() + snp_idx - read_info.start_index()];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Indexes the fragments which have a value at each snp
+    // ------------------------------------------------------------------------------------------------------
+    void map_snp_frags();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the neighbours of each fragment, and the relations to them, in parallel
+    // ------------------------------------------------------------------------------------------------------
+    void map_relations();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Greedily packs fragment disjoint conflicting pairs, and then triangles
+    // ------------------------------------------------------------------------------------------------------
+    void pack_conflicts();
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline LowerBound::LowerBound(const data_type& data)
+: _data(&data), _snp_offsets(data.snps + 1, 0), _offsets(data.reads + 1, 0), _pairs(0), _triangles(0)
+{
+    map_snp_frags();
+    map_relations();
+    pack_conflicts();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline void LowerBound::map_snp_frags()
+{
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        const auto& read_info = _data->read_info[frag_idx];
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx)
+            if (value(frag_idx, snp_idx) <= 1) ++_snp_offsets[snp_idx + 1];
+    }
+    for (size_t snp_idx = 0; snp_idx < _data->snps; ++snp_idx)
+        _snp_offsets[snp_idx + 1] += _snp_offsets[snp_idx];
+
+    _snp_frags.resize(_snp_offsets[_data->snps]);
+    count_container snp_fill(_snp_offsets.begin(), _snp_offsets.end() - 1);
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        const auto& read_info = _data->read_info[frag_idx];
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx)
+            if (value(frag_idx, snp_idx) <= 1) _snp_frags[snp_fill[snp_idx]++] = frag_idx;
+    }
+}
+
+inline void LowerBound::map_relations()
+{
+    std::vector<count_container> neighbours(_data->reads);
+    std::vector<small_container> relations(_data->reads);
+
+    // The relations to the other fragments are cleared after each fragment, so each thread reuses one
+    // buffer rather than each chunk allocating its own
+    const size_t reads = _data->reads;
+    tbb::enumerable_thread_specific<small_container> buffers([reads] { return small_container(reads, 0); });
+
+    // Each fragment finds its own neighbours, so there are no shared writes
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _data->reads),
+        [&](const tbb::blocked_range<size_t>& frags)
+        {
+            auto& relation = buffers.local();
+            for (size_t frag_idx = frags.begin(); frag_idx != frags.end(); ++frag_idx) {
+                const auto& read_info = _data->read_info[frag_idx];
+                auto&       others    = neighbours[frag_idx];
+
+                for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+                    const small_type frag_value = value(frag_idx, snp_idx);
+                    if (frag_value > 1) continue;
+
+                    const bool ih = _data->snp_info[snp_idx].type() == IH;
+                    for (size_t i = _snp_offsets[snp_idx]; i < _snp_offsets[snp_idx + 1]; ++i) {
+                        const size_t other = _snp_frags[i];
+                        if (other == frag_idx) continue;
+                        if (!(relation[other] & seen)) {
+                            others.push_back(other);
+                            relation[other] |= seen;
+                        }
+
+                        if (value(other, snp_idx) != frag_value) relation[other] |= differ;
+                        else if (ih)                              relation[other] |= agree;
+                    }
+                }
+
+                // The relation of a neighbour is zero if the fragments only agree at NIH snps
+                std::sort(others.begin(), others.end());
+                for (const auto other : others) relations[frag_idx].push_back(relation[other] & ~seen);
+                for (const auto other : others) relation[other] = 0;
+            }
+        }
+    );
+
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx)
+        _offsets[frag_idx + 1] = _offsets[frag_idx] + neighbours[frag_idx].size();
+    _neighbours.reserve(_offsets[_data->reads]);
+    _relations.reserve(_offsets[_data->reads]);
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        _neighbours.insert(_neighbours.end(), neighbours[frag_idx].begin(), neighbours[frag_idx].end());
+        _relations.insert(_relations.end(), relations[frag_idx].begin(), relations[frag_idx].end());
+    }
+}
+
+inline void LowerBound::pack_conflicts()
+{
+    std::vector<bool> used(_data->reads, false);
+
+    // A pair which has to be in both the same and different sets always has an error
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        for (size_t i = _offsets[frag_idx]; i < _offsets[frag_idx + 1] && !used[frag_idx]; ++i) {
+            if (_relations[i] != (differ | agree) || used[_neighbours[i]]) continue;
+            used[frag_idx] = used[_neighbours[i]] = true;
+            ++_pairs;
+        }
+    }
+
+    // A triangle with an odd number of differ relations can't be split into two consistent sets
+    small_container relation(_data->reads, 0);
+    for (size_t frag_one = 0; frag_one < _data->reads; ++frag_one) {
+        if (used[frag_one]) continue;
+        for (size_t i = _offsets[frag_one]; i < _offsets[frag_one + 1]; ++i)
+            relation[_neighbours[i]] = _relations[i];
+
+        for (size_t i = _offsets[frag_one]; i < _offsets[frag_one + 1] && !used[frag_one]; ++i) {
+            const size_t frag_two = _neighbours[i];
+            if (used[frag_two] || _relations[i] == 0 || _relations[i] == (differ | agree)) continue;
+
+            for (size_t j = _offsets[frag_two]; j < _offsets[frag_two + 1]; ++j) {
+                const size_t frag_three = _neighbours[j];
+                const small_type one_three = relation[frag_three];
+                if (frag_three == frag_one || used[frag_three] || _relations[j] == 0   ||
+                    _relations[j] == (differ | agree) || one_three == 0 || one_three == (differ | agree))
+                    continue;
+
+                if (((_relations[i] & differ) ^ (_relations[j] & differ) ^ (one_three & differ)) != 0) {
+                    used[frag_one] = used[frag_two] = used[frag_three] = true;
+                    ++_triangles;
+                    break;
+                }
+            }
+        }
+
+        for (size_t i = _offsets[frag_one]; i < _offsets[frag_one + 1]; ++i)
+            relation[_neighbours[i]] = 0;
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_LOWER_BOUND_HPP
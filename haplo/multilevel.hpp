@@ -0,0 +1,543 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   multilevel.hpp
+/// @brief  Header file for the multilevel solver, which finds the haplotypes of large sub-blocks by
+///         coarsening the fragments into super-fragments, partitioning the coarsest level, and then
+///         refining the partition at each level as it is uncoarsened
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_MULTILEVEL_HPP
+#define PARAHAPLO_MULTILEVEL_HPP
+
+#include "data.h"
+#include "partition.hpp"
+
+#include <tbb/tbb.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#ifndef MULTILEVEL_COARSEST
+    #define MULTILEVEL_COARSEST     64      // Coarsening stops at this many super-fragments
+#endif
+#define MULTILEVEL_MIN_SHRINK       0.9     // Coarsening stops if a level keeps more than this fraction
+#define MULTILEVEL_PASSES           8       // Largest number of refinement passes at each level
+#define MULTILEVEL_MIN_SCORE        2       // Smallest agreement score for two nodes to be merged
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      MultilevelSolver
+/// @brief      Finds the haplotypes of a sub-block with a multilevel partitioning. Duplicate reads start as a
+///             single super-fragment, weighted by their multiplicity. Each coarsening matches every
+///             super-fragment with the overlapping one it agrees with most (heavy edge matching), and merges
+///             the pair, keeping the zeros and ones of each snp. The coarsest level is partitioned greedily,
+///             and each level is refined by moving super-fragments while that reduces the MEC score, which
+///             is exact at every level since the allele counts are kept. Each level is linear in the number
+///             of elements (times the coverage for the matching), so large sub-blocks solve in near linear
+///             time.
+/// @tparam     SubBlockType    The type of the sub-block to solve
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class MultilevelSolver {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using data_type                     = Data;
+    using partition_type                = Partition;
+    using read_info_type                = typename data_type::read_info_type;
+    using read_info_container           = thrust::host_vector<read_info_type>;
+    using snp_info_type                 = typename data_type::snp_info_type;
+    using snp_info_container            = thrust::host_vector<snp_info_type>;
+    using small_type                    = typename data_type::small_type;
+    using small_container               = thrust::host_vector<small_type>;
+    using set_container                 = std::vector<small_type>;
+    using index_container               = std::vector<size_t>;
+    using score_type                    = int64_t;
+    using score_container               = std::vector<score_type>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t no_node     = std::numeric_limits<size_t>::max();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Alleles
+    /// @brief      The number of zeros and ones of a super-fragment at a snp
+    // ------------------------------------------------------------------------------------------------------
+    struct Alleles {
+        size_t  snp;                    //!< The index of the snp
+        size_t  zeros;                  //!< The number of zeros at the snp
+        size_t  ones;                   //!< The number of ones at the snp
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Level
+    /// @brief      The super-fragments (nodes) of a level -- the alleles of each node are sorted by snp
+    // ------------------------------------------------------------------------------------------------------
+    struct Level {
+        index_container         offsets;        //!< Offset of the alleles of each node
+        std::vector<Alleles>    alleles;        //!< The alleles of all the nodes
+        index_container         parents;        //!< The node of the next coarser level of each node
+        set_container           sets;           //!< The set (1 | 2) of each node
+
+        inline size_t nodes() const { return offsets.size() - 1; }
+    };
+    // ------------------------------------------------------------------------------------------------------
+private:
+    SubBlockType&               _sub_block;
+    small_container             _data_cpu;              //!< The sub-block data, one element per byte
+    read_info_container&        _read_info;             //!< The information for each read
+    snp_info_container          _snp_info;              //!< The information for each snp
+    size_t                      _snps;                  //!< The number of snps in the sub-block
+    size_t                      _reads;                 //!< The number of reads in the sub-block
+    size_t                      _coarsest;              //!< The number of nodes to coarsen to
+    size_t                      _mec_score;             //!< The MEC score of the solution
+    index_container             _frag_nodes;            //!< The node of each fragment in the finest level
+    std::vector<Level>          _levels;                //!< The levels, from the finest to the coarsest
+    index_container             _counts;                //!< Zeros and ones of each snp in each set
+    data_type                   _data;                  //!< View of the data for the partition
+    partition_type              _partition;             //!< The partition of the fragments
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  sub_block   The sub-block to find the haplotypes of
+    /// @param[in]  coarsest    The number of nodes at which the coarsening stops
+    // ------------------------------------------------------------------------------------------------------
+    explicit MultilevelSolver(SubBlockType& sub_block, const size_t coarsest = MULTILEVEL_COARSEST);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the haplotypes and puts them in the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of levels which were used
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t levels() const { return _levels.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of nodes of a level
+    /// @param[in]  level   The index of the level (0 is the finest)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t nodes(const size_t level) const { return _levels[level].nodes(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the partition of the fragments
+    // ------------------------------------------------------------------------------------------------------
+    inline const partition_type& partition() const { return _partition; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the view of the data which the partition operates on
+    // ------------------------------------------------------------------------------------------------------
+    data_type data_view();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of a read at a snp which the read covers
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type value(const size_t read_idx, const size_t snp_idx) const
+    {
+        const auto& read_info = _read_info[read_idx];
+        return _data_cpu[read_info.offset() + snp_idx - read_info.start_index()];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the cost of a snp from the zeros and ones of each set
+    /// @param[in]  snp_idx     The index of the snp
+    /// @param[in]  counts      The zeros and ones in set one, then in set two
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t snp_cost(const size_t snp_idx, const size_t* counts) const
+    {
+        // IH snps must have complementary haplotypes (as for the partition)
+        return _snp_info[snp_idx].type() == IH
+             ? std::min(counts[1] + counts[2], counts[0] + counts[3])
+             : std::min(counts[0], counts[1]) + std::min(counts[2], counts[3]);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if two reads have the same span and the same elements
+    /// @param[in]  read_one    The index of the first read
+    /// @param[in]  read_two    The index of the second read
+    // ------------------------------------------------------------------------------------------------------
+    inline bool identical(const size_t read_one, const size_t read_two) const
+    {
+        const auto& info_one = _read_info[read_one];
+        const auto& info_two = _read_info[read_two];
+        if (info_one.start_index() != info_two.start_index() || info_one.end_index() != info_two.end_index())
+            return false;
+        for (size_t snp_idx = info_one.start_index(); snp_idx <= info_one.end_index(); ++snp_idx)
+            if (value(read_one, snp_idx) != value(read_two, snp_idx)) return false;
+        return true;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the finest level, where each node is a read and its duplicates
+    // ------------------------------------------------------------------------------------------------------
+    void build_finest();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Matches the nodes of the coarsest level and adds the level of the merged nodes
+    /// @return     False if the matching did not shrink the level enough, in which case no level is added
+    // ------------------------------------------------------------------------------------------------------
+    bool coarsen();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges the (sorted) alleles of two nodes
+    /// @param[in]  level   The level of the nodes
+    /// @param[in]  one     The first node
+    /// @param[in]  two     The second node, or no_node to copy the first
+    /// @param[out] merged  Where to put the merged alleles, nullptr to only count them
+    /// @return     The number of merged alleles
+    // ------------------------------------------------------------------------------------------------------
+    size_t merge_alleles(const Level& level, const size_t one, const size_t two, Alleles* merged) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Partitions the coarsest level greedily, putting each node in the cheaper set
+    // ------------------------------------------------------------------------------------------------------
+    void initial_partition();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the nodes of a level while that reduces the MEC score
+    /// @param[in]  level   The level to refine
+    // ------------------------------------------------------------------------------------------------------
+    void refine(Level& level);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the change in the MEC score from moving a node to a set
+    /// @param[in]  level   The level of the node
+    /// @param[in]  node    The node to move
+    /// @param[in]  set     The set to move the node to
+    // ------------------------------------------------------------------------------------------------------
+    score_type move_delta(const Level& level, const size_t node, const small_type set) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves a node to a set
+    /// @param[in]  level   The level of the node
+    /// @param[in]  node    The node to move
+    /// @param[in]  set     The set to move the node to
+    // ------------------------------------------------------------------------------------------------------
+    void move(Level& level, const size_t node, const small_type set);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the result of the haplotype to the sub block
+    // ------------------------------------------------------------------------------------------------------
+    void set_sub_block_haplotypes();
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+template <typename SubBlockType>
+constexpr size_t MultilevelSolver<SubBlockType>::no_node;
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename SubBlockType>
+MultilevelSolver<SubBlockType>::MultilevelSolver(SubBlockType& sub_block, const size_t coarsest)
+: _sub_block(sub_block)                             , _data_cpu(sub_block.data().to_binary_vector())  ,
+  _read_info(sub_block.read_info())                 , _snp_info(sub_block.snp_info())                 ,
+  _snps(_snp_info.size())                           , _reads(_read_info.size())                       ,
+  _coarsest(std::max(coarsest, size_t(1)))          , _mec_score(std::numeric_limits<size_t>::max()) ,
+  _frag_nodes(_read_info.size(), 0)                 , _counts(4 * _snp_info.size(), 0)                ,
+  _data(data_view())                                , _partition(_data)
+{}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::search()
+{
+    build_finest();
+    while (_levels.back().nodes() > _coarsest && coarsen()) {}
+
+    initial_partition();
+    refine(_levels.back());
+
+    // Uncoarsen -- each node starts in the set of its parent
+    for (size_t level_idx = _levels.size() - 1; level_idx-- > 0; ) {
+        auto&       level  = _levels[level_idx];
+        const auto& parent = _levels[level_idx + 1];
+        for (size_t node = 0; node < level.nodes(); ++node)
+            level.sets[node] = parent.sets[level.parents[node]];
+        refine(level);
+    }
+
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx)
+        _partition.assign(frag_idx, _levels.front().sets[_frag_nodes[frag_idx]]);
+    _mec_score = _partition.mec_score();
+
+    // Put the haplotypes back into the sub_block
+    set_sub_block_haplotypes();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+typename MultilevelSolver<SubBlockType>::data_type MultilevelSolver<SubBlockType>::data_view()
+{
+    data_type data(_snps, _reads);
+    data.data      = _data_cpu.size()  > 0 ? thrust::raw_pointer_cast(&_data_cpu[0])  : nullptr;
+    data.read_info = _read_info.size() > 0 ? thrust::raw_pointer_cast(&_read_info[0]) : nullptr;
+    data.snp_info  = _snp_info.size()  > 0 ? thrust::raw_pointer_cast(&_snp_info[0])  : nullptr;
+    return data;
+}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::build_finest()
+{
+    // Duplicates join the node of the read they duplicate -- the duplicate rows of the sub-block ignore the
+    // duplicate columns, so the reads are checked to be identical
+    index_container firsts;
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx) {
+        size_t original = frag_idx;
+        while (_sub_block._duplicate_rows.find(original) != _sub_block._duplicate_rows.end() &&
+               _sub_block._duplicate_rows.at(original) < original)
+            original = _sub_block._duplicate_rows.at(original);
+        if (original != frag_idx && !identical(original, frag_idx)) original = frag_idx;
+
+        if (original == frag_idx) {
+            _frag_nodes[frag_idx] = firsts.size();
+            firsts.push_back(frag_idx);
+        } else {
+            _frag_nodes[frag_idx] = _frag_nodes[original];
+        }
+    }
+
+    std::vector<index_container> members(firsts.size());
+    for (size_t frag_idx = 0; frag_idx < _reads; ++frag_idx)
+        members[_frag_nodes[frag_idx]].push_back(frag_idx);
+
+    Level level;
+    level.offsets.assign(1, 0);
+    for (const auto& node_members : members) {
+        size_t start = _snps, end = 0;
+        for (const auto frag_idx : node_members) {
+            start = std::min(start, _read_info[frag_idx].start_index());
+            end   = std::max(end  , _read_info[frag_idx].end_index()  );
+        }
+        for (size_t snp_idx = start; snp_idx <= end; ++snp_idx) {
+            Alleles alleles{snp_idx, 0, 0};
+            for (const auto frag_idx : node_members) {
+                if (!_read_info[frag_idx].element_exists(snp_idx)) continue;
+                const small_type element = value(frag_idx, snp_idx);
+                if (element == 0) ++alleles.zeros;
+                if (element == 1) ++alleles.ones;
+            }
+            if (alleles.zeros + alleles.ones > 0) level.alleles.push_back(alleles);
+        }
+        level.offsets.push_back(level.alleles.size());
+    }
+    level.parents.assign(level.nodes(), 0);
+    level.sets.assign(level.nodes(), 0);
+    _levels.push_back(std::move(level));
+}
+
+template <typename SubBlockType>
+bool MultilevelSolver<SubBlockType>::coarsen()
+{
+    auto&        fine  = _levels.back();
+    const size_t nodes = fine.nodes();
+
+    // Index the alleles of each snp, and the node which each allele belongs to
+    index_container snp_offsets(_snps + 1, 0), snp_alleles(fine.alleles.size()), owners(fine.alleles.size());
+    for (size_t node = 0; node < nodes; ++node)
+        for (size_t i = fine.offsets[node]; i < fine.offsets[node + 1]; ++i) owners[i] = node;
+    for (const auto& alleles : fine.alleles) ++snp_offsets[alleles.snp + 1];
+    for (size_t snp_idx = 0; snp_idx < _snps; ++snp_idx) snp_offsets[snp_idx + 1] += snp_offsets[snp_idx];
+    index_container snp_fill(snp_offsets.begin(), snp_offsets.end() - 1);
+    for (size_t i = 0; i < fine.alleles.size(); ++i) snp_alleles[snp_fill[fine.alleles[i].snp]++] = i;
+
+    // Visit the nodes from left to right, so that matched nodes are local
+    index_container order(nodes);
+    for (size_t node = 0; node < nodes; ++node) order[node] = node;
+    const auto first_snp = [&](const size_t node)
+    {
+        return fine.offsets[node] < fine.offsets[node + 1] ? fine.alleles[fine.offsets[node]].snp : _snps;
+    };
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
+    {
+        return first_snp(a) != first_snp(b) ? first_snp(a) < first_snp(b) : a < b;
+    });
+
+    // Match each node with the unmatched node it agrees with most -- the score is the number of pairs of
+    // elements of the two nodes which agree, less the number which disagree
+    index_container matches(nodes, no_node), visited(nodes, no_node), touched;
+    score_container scores(nodes, 0);
+    for (const auto node : order) {
+        if (matches[node] != no_node) continue;
+
+        touched.clear();
+        for (size_t i = fine.offsets[node]; i < fine.offsets[node + 1]; ++i) {
+            const auto& alleles = fine.alleles[i];
+            for (size_t j = snp_offsets[alleles.snp]; j < snp_offsets[alleles.snp + 1]; ++j) {
+                const size_t other = owners[snp_alleles[j]];
+                if (other == node || matches[other] != no_node) continue;
+                if (visited[other] != node) {
+                    visited[other] = node;
+                    scores[other]  = 0;
+                    touched.push_back(other);
+                }
+                const auto& other_alleles = fine.alleles[snp_alleles[j]];
+                scores[other] += static_cast<score_type>(alleles.zeros * other_alleles.zeros +
+                                                         alleles.ones  * other_alleles.ones  )
+                               - static_cast<score_type>(alleles.zeros * other_alleles.ones  +
+                                                         alleles.ones  * other_alleles.zeros );
+            }
+        }
+
+        size_t best = no_node;
+        for (const auto other : touched) {
+            if (scores[other] < MULTILEVEL_MIN_SCORE) continue;
+            if (best == no_node || scores[other] > scores[best] ||
+                (scores[other] == scores[best] && other < best)) best = other;
+        }
+        matches[node] = best == no_node ? node : best;
+        if (best != no_node) matches[best] = node;
+    }
+
+    // Number the merged nodes in the order they were visited
+    index_container firsts, seconds;
+    std::fill(fine.parents.begin(), fine.parents.end(), no_node);
+    for (const auto node : order) {
+        if (fine.parents[node] != no_node) continue;
+        fine.parents[node] = firsts.size();
+        if (matches[node] != node) fine.parents[matches[node]] = firsts.size();
+        firsts.push_back(node);
+        seconds.push_back(matches[node] != node ? matches[node] : no_node);
+    }
+
+    const size_t coarse_nodes = firsts.size();
+    if (coarse_nodes > MULTILEVEL_MIN_SHRINK * nodes) return false;
+
+    // Merge the alleles of the matched nodes, in parallel
+    Level coarse;
+    coarse.offsets.assign(coarse_nodes + 1, 0);
+    tbb::parallel_for(size_t(0), coarse_nodes, [&](const size_t node)
+    {
+        coarse.offsets[node + 1] = merge_alleles(fine, firsts[node], seconds[node], nullptr);
+    });
+    for (size_t node = 0; node < coarse_nodes; ++node) coarse.offsets[node + 1] += coarse.offsets[node];
+
+    coarse.alleles.resize(coarse.offsets[coarse_nodes]);
+    tbb::parallel_for(size_t(0), coarse_nodes, [&](const size_t node)
+    {
+        merge_alleles(fine, firsts[node], seconds[node], &coarse.alleles[coarse.offsets[node]]);
+    });
+    coarse.parents.assign(coarse_nodes, 0);
+    coarse.sets.assign(coarse_nodes, 0);
+
+    _levels.push_back(std::move(coarse));
+    return true;
+}
+
+template <typename SubBlockType>
+size_t MultilevelSolver<SubBlockType>::merge_alleles(const Level& level, const size_t one, const size_t two,
+                                                     Alleles* merged) const
+{
+    size_t i = level.offsets[one], i_end = level.offsets[one + 1], merged_size = 0;
+    size_t j = 0, j_end = 0;
+    if (two != no_node) { j = level.offsets[two]; j_end = level.offsets[two + 1]; }
+
+    while (i < i_end || j < j_end) {
+        Alleles alleles;
+        if (j == j_end || (i < i_end && level.alleles[i].snp < level.alleles[j].snp)) {
+            alleles = level.alleles[i++];
+        } else if (i == i_end || level.alleles[j].snp < level.alleles[i].snp) {
+            alleles = level.alleles[j++];
+        } else {
+            alleles        = level.alleles[i++];
+            alleles.zeros += level.alleles[j].zeros;
+            alleles.ones  += level.alleles[j++].ones;
+        }
+        if (merged != nullptr) merged[merged_size] = alleles;
+        ++merged_size;
+    }
+    return merged_size;
+}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::initial_partition()
+{
+    auto& level = _levels.back();
+    std::fill(_counts.begin(), _counts.end(), 0);
+    std::fill(level.sets.begin(), level.sets.end(), 0);
+
+    for (size_t node = 0; node < level.nodes(); ++node)
+        move(level, node, move_delta(level, node, 1) <= move_delta(level, node, 2) ? 1 : 2);
+}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::refine(Level& level)
+{
+    // Count the alleles of each set from scratch, since the sets came from the coarser level
+    std::fill(_counts.begin(), _counts.end(), 0);
+    for (size_t node = 0; node < level.nodes(); ++node) {
+        const size_t set_offset = 2 * (level.sets[node] - 1);
+        for (size_t i = level.offsets[node]; i < level.offsets[node + 1]; ++i) {
+            _counts[4 * level.alleles[i].snp + set_offset    ] += level.alleles[i].zeros;
+            _counts[4 * level.alleles[i].snp + set_offset + 1] += level.alleles[i].ones;
+        }
+    }
+
+    for (size_t pass = 0; pass < MULTILEVEL_PASSES; ++pass) {
+        size_t moves = 0;
+        for (size_t node = 0; node < level.nodes(); ++node) {
+            const small_type other_set = level.sets[node] == 1 ? 2 : 1;
+            if (move_delta(level, node, other_set) < 0) {
+                move(level, node, other_set);
+                ++moves;
+            }
+        }
+        if (moves == 0) break;
+    }
+}
+
+template <typename SubBlockType>
+typename MultilevelSolver<SubBlockType>::score_type
+MultilevelSolver<SubBlockType>::move_delta(const Level& level, const size_t node, const small_type set) const
+{
+    const small_type from  = level.sets[node];
+    score_type       delta = 0;
+    for (size_t i = level.offsets[node]; i < level.offsets[node + 1]; ++i) {
+        const auto& alleles = level.alleles[i];
+        size_t      counts[4];
+        std::copy(&_counts[4 * alleles.snp], &_counts[4 * alleles.snp] + 4, counts);
+        delta -= static_cast<score_type>(snp_cost(alleles.snp, counts));
+
+        if (from != 0) {
+            counts[2 * (from - 1)    ] -= alleles.zeros;
+            counts[2 * (from - 1) + 1] -= alleles.ones;
+        }
+        counts[2 * (set - 1)    ] += alleles.zeros;
+        counts[2 * (set - 1) + 1] += alleles.ones;
+        delta += static_cast<score_type>(snp_cost(alleles.snp, counts));
+    }
+    return delta;
+}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::move(Level& level, const size_t node, const small_type set)
+{
+    const small_type from = level.sets[node];
+    for (size_t i = level.offsets[node]; i < level.offsets[node + 1]; ++i) {
+        const auto& alleles = level.alleles[i];
+        if (from != 0) {
+            _counts[4 * alleles.snp + 2 * (from - 1)    ] -= alleles.zeros;
+            _counts[4 * alleles.snp + 2 * (from - 1) + 1] -= alleles.ones;
+        }
+        _counts[4 * alleles.snp + 2 * (set - 1)    ] += alleles.zeros;
+        _counts[4 * alleles.snp + 2 * (set - 1) + 1] += alleles.ones;
+    }
+    level.sets[node] = set;
+}
+
+template <typename SubBlockType>
+void MultilevelSolver<SubBlockType>::set_sub_block_haplotypes()
+{
+    for (size_t i = 0; i < _snps; ++i) {
+        _sub_block._haplo_one.set(i, _partition.haplo_one()[i]);
+        _sub_block._haplo_two.set(i, _partition.haplo_two()[i]);
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_MULTILEVEL_HPP
@@ -0,0 +1,118 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   packed_edge.hpp
+/// @brief  Header file for the packed edge class, an 8 byte edge for the cpu solvers, which is sorted by
+///         comparing a single integer key
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_PACKED_EDGE_HPP
+#define PARAHAPLO_PACKED_EDGE_HPP
+
+#include <cmath>
+#include <stdint.h>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      PackedEdge
+/// @brief      An edge between two fragments, packed into a 64 bit key. From the most significant bit the
+///             key holds the inverted confidence (the distance from 1, quantized to 15 bits), the first and
+///             second fragment indices (24 bits each), and the side of 1 which the distance is on. Sorting
+///             the keys in ascending order therefore gives the most confident edges first, with ties
+///             ordered by the fragment indices -- the same order as sorting the 16 byte Edge.
+// ----------------------------------------------------------------------------------------------------------
+class PackedEdge {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using key_type  = uint64_t;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr key_type frag_bits         = 24;
+    static constexpr key_type confidence_bits   = 15;
+    static constexpr key_type max_fragments     = key_type(1) << frag_bits;
+    static constexpr key_type max_confidence    = (key_type(1) << confidence_bits) - 1;
+private:
+    static constexpr key_type frag_mask         = max_fragments - 1;
+    static constexpr key_type two_shift         = 1;
+    static constexpr key_type one_shift         = two_shift + frag_bits;
+    static constexpr key_type confidence_shift  = one_shift + frag_bits;
+
+    key_type    _key;           //!< The packed confidence, fragments and side
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor -- the least confident edge between fragment 0 and itself
+    // ------------------------------------------------------------------------------------------------------
+    PackedEdge() noexcept : _key(max_confidence << confidence_shift) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor to set the variables
+    /// @param[in]  dist        The distance between the fragments (in [0.5, 1.5])
+    /// @param[in]  frag_one    The index of the first fragment (less than max_fragments)
+    /// @param[in]  frag_two    The index of the second fragment (less than max_fragments)
+    // ------------------------------------------------------------------------------------------------------
+    PackedEdge(const float dist, const key_type frag_one, const key_type frag_two) noexcept
+    : _key(((max_confidence - quantize(dist)) << confidence_shift) |
+           ((frag_one & frag_mask)            << one_shift       ) |
+           ((frag_two & frag_mask)            << two_shift       ) | (dist > 1.0f ? 1 : 0)) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the index of the first fragment
+    // ------------------------------------------------------------------------------------------------------
+    inline key_type f1() const { return (_key >> one_shift) & frag_mask; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the index of the second fragment
+    // ------------------------------------------------------------------------------------------------------
+    inline key_type f2() const { return (_key >> two_shift) & frag_mask; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If the fragments should be in opposite sets (the distance is greater than 1)
+    // ------------------------------------------------------------------------------------------------------
+    inline bool opposite() const { return _key & 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the quantized confidence of the edge (0 for a distance of 1)
+    // ------------------------------------------------------------------------------------------------------
+    inline key_type confidence() const { return max_confidence - (_key >> confidence_shift); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the (quantized) distance between the fragments
+    // ------------------------------------------------------------------------------------------------------
+    inline float distance() const
+    {
+        const float offset = static_cast<float>(confidence()) / static_cast<float>(2 * max_confidence);
+        return opposite() ? 1.0f + offset : 1.0f - offset;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the packed key
+    // ------------------------------------------------------------------------------------------------------
+    inline key_type key() const { return _key; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Orders the edges by confidence (descending), and then by the fragment indices
+    /// @param[in]  other   The edge to compare against
+    // ------------------------------------------------------------------------------------------------------
+    inline bool operator<(const PackedEdge& other) const { return _key < other._key; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If two edges are between the same fragments
+    /// @param[in]  other   The edge to compare against
+    // ------------------------------------------------------------------------------------------------------
+    inline bool same_fragments(const PackedEdge& other) const
+    {
+        return ((_key ^ other._key) >> two_shift & ((key_type(1) << (2 * frag_bits)) - 1)) == 0;
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Quantizes the confidence (|distance - 1|, at most 0.5) of a distance to 15 bits
+    /// @param[in]  dist    The distance to quantize
+    // ------------------------------------------------------------------------------------------------------
+    static inline key_type quantize(const float dist)
+    {
+        const float confidence = std::fabs(dist - 1.0f) * static_cast<float>(2 * max_confidence);
+        return confidence >= static_cast<float>(max_confidence)
+             ? max_confidence : static_cast<key_type>(std::lround(confidence));
+    }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_PACKED_EDGE_HPP
@@ -0,0 +1,421 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   partition.hpp
+/// @brief  Header file for the partition class, which holds a bipartition of the fragments of a sub-block
+///         and incrementally maintains the allele counts of each set, the consensus haplotypes, the
+///         mismatches of each fragment and the MEC score, so that moving a fragment only touches the snps
+///         which the fragment covers
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_PARTITION_HPP
+#define PARAHAPLO_PARTITION_HPP
+
+#include "data.h"
+#include "sparse_reads.hpp"
+
+#include <tbb/tbb.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifndef NIH
+    #define IH  0x00
+    #define NIH 0x01
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Partition
+/// @brief      A bipartition of the fragments (reads) of a sub-block. For each snp the number of zeros and
+///             ones in each of the sets is stored, from which the consensus haplotypes and the contribution
+///             of the snp to the MEC score follow in constant time. IH snps are constrained to have
+///             complementary haplotypes (which is what check_haplotypes does for the GPU implementation).
+// ----------------------------------------------------------------------------------------------------------
+class Partition {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using data_type         = Data;
+    using small_type        = uint8_t;
+    using small_container   = std::vector<small_type>;
+    using count_container   = std::vector<size_t>;
+    using delta_type        = int64_t;
+    using sparse_pointer    = std::shared_ptr<const SparseReads>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr small_type unassigned = 0;
+private:
+    const data_type*    _data;              //!< The data for the sub-block which is partitioned
+    sparse_pointer      _sparse;            //!< The values of the mostly gap fragments (shared by copies)
+    count_container     _snp_offsets;       //!< Offset of the fragments of each snp in _snp_frags
+    count_container     _snp_frags;         //!< The fragments with a value (0 | 1) at each snp
+    small_container     _sets;              //!< The set (1 | 2) of each fragment, 0 if unassigned
+    count_container     _counts;            //!< Zeros and ones of each snp in set one, then in set two
+    count_container     _mismatches;        //!< Elements of each fragment which differ from its haplotype
+    small_container     _haplo_one;         //!< The consensus haplotype of set one
+    small_container     _haplo_two;         //!< The consensus haplotype of set two
+    size_t              _set_one_size;      //!< The number of fragments in set one
+    size_t              _set_two_size;      //!< The number of fragments in set two
+    size_t              _mec_score;         //!< The MEC score of the partition
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- creates an empty partition (all fragments unassigned) for the data
+    /// @param[in]  data    The data of the sub-block to partition
+    // ------------------------------------------------------------------------------------------------------
+    explicit Partition(const data_type& data);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the partition
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the set (1 | 2) of a fragment, or 0 if the fragment is not assigned
+    /// @param[in]  frag_idx    The index of the fragment
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type set(const size_t frag_idx) const { return _sets[frag_idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of elements of a fragment which differ from the haplotype of its set
+    /// @param[in]  frag_idx    The index of the fragment
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mismatches(const size_t frag_idx) const { return _mismatches[frag_idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the consensus haplotype of the first set
+    // ------------------------------------------------------------------------------------------------------
+    inline const small_container& haplo_one() const { return _haplo_one; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the consensus haplotype of the second set
+    // ------------------------------------------------------------------------------------------------------
+    inline const small_container& haplo_two() const { return _haplo_two; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragments in the first set
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t set_one_size() const { return _set_one_size; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragments in the second set
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t set_two_size() const { return _set_two_size; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragments with a value (0 | 1) at a snp -- the coverage of the snp
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t coverage(const size_t snp_idx) const
+    {
+        return _snp_offsets[snp_idx + 1] - _snp_offsets[snp_idx];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a pointer to the first of the fragments with a value (0 | 1) at a snp
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline const size_t* snp_frags_begin(const size_t snp_idx) const
+    {
+        return _snp_frags.data() + _snp_offsets[snp_idx];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a pointer to one past the last of the fragments with a value (0 | 1) at a snp
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline const size_t* snp_frags_end(const size_t snp_idx) const
+    {
+        return _snp_frags.data() + _snp_offsets[snp_idx + 1];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragments (partitioned or not)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t fragments() const { return _sets.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Puts a fragment into a set, removing it from the set it was in -- O(read length) plus the
+    ///             coverage of any snp whose consensus value changes
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  set         The set to put the fragment in (1 | 2)
+    // ------------------------------------------------------------------------------------------------------
+    void assign(const size_t frag_idx, const small_type set);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves a fragment to the other set
+    /// @param[in]  frag_idx    The index of the (assigned) fragment to move
+    // ------------------------------------------------------------------------------------------------------
+    inline void move(const size_t frag_idx) { assign(frag_idx, _sets[frag_idx] == 1 ? 2 : 1); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves a batch of fragments to their other sets in parallel. The spans of the fragments
+    ///             must not overlap, so that each snp is changed by at most one of the moves, which makes
+    ///             the moves independent -- the change in the MEC score is the sum of their move deltas
+    /// @param[in]  frags   The indices of the (assigned) fragments to move
+    // ------------------------------------------------------------------------------------------------------
+    void move_batch(const std::vector<size_t>& frags);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the change in the MEC score if a fragment were moved to the other set, without
+    ///             modifying the partition -- O(read length)
+    /// @param[in]  frag_idx    The index of the (assigned) fragment
+    /// @return     The new MEC score minus the current MEC score
+    // ------------------------------------------------------------------------------------------------------
+    delta_type move_delta(const size_t frag_idx) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the number of elements of a fragment which conflict with the haplotype of a set
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  set         The set whose haplotype the fragment is compared against (1 | 2)
+    // ------------------------------------------------------------------------------------------------------
+    size_t conflicts(const size_t frag_idx, const small_type set) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the snp and the value of each value (0 | 1) of a fragment -- from
+    ///             the entries of a sparse fragment, or by scanning the span of a dense one
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  function    The function to call with the snp and the value
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    inline void for_each_value(const size_t frag_idx, Function function) const
+    {
+        const auto& read_info = _data->read_info[frag_idx];
+        _sparse->for_each_value(frag_idx, read_info.start_index(), read_info.end_index(),
+                                [&](const size_t snp_idx) { return value(frag_idx, snp_idx); }, function);
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of a fragment at a snp which the fragment covers
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type value(const size_t frag_idx, const size_t snp_idx) const
+    {
+        const auto& read_info = _data->read_info[frag_idx];
+        return _data->data[read_info.offset() + snp_idx - read_info.start_index()];
+    }
+
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the consensus values and the MEC contribution of a snp from its counts
+    /// @param[in]  snp_idx     The index of the snp
+    /// @param[in]  counts      The zeros and ones of set one followed by the zeros and ones of set two
+    /// @param[out] value_one   The consensus value of the first haplotype
+    /// @param[out] value_two   The consensus value of the second haplotype
+    /// @return     The number of elements in the snp which differ from the consensus of their set
+    // ------------------------------------------------------------------------------------------------------
+    size_t consensus(const size_t  snp_idx  , const size_t* counts,
+                     small_type&   value_one, small_type&   value_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Recomputes the consensus of a snp after its counts changed, and updates the mismatches of
+    ///             the fragments covering it (other than the moving fragment) if a haplotype value changed
+    /// @param[in]  snp_idx     The index of the snp
+    /// @param[in]  frag_idx    The index of the fragment which is being moved
+    // ------------------------------------------------------------------------------------------------------
+    void update_snp(const size_t snp_idx, const size_t frag_idx);
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline Partition::Partition(const data_type& data)
+: _data(&data), _snp_offsets(data.snps + 1, 0), _sets(data.reads, small_type(unassigned)),
+  _counts(4 * data.snps, 0), _mismatches(data.reads, 0), _haplo_one(data.snps, 0), _haplo_two(data.snps, 0),
+  _set_one_size(0), _set_two_size(0), _mec_score(0)
+{
+    // The fragments which are mostly gaps are scanned by their values
+    auto sparse = std::make_shared<SparseReads>();
+    sparse->build(_data->reads,
+                  [&](const size_t frag_idx) -> const ReadInfo& { return _data->read_info[frag_idx]; },
+                  [&](const size_t frag_idx, const size_t snp_idx) { return value(frag_idx, snp_idx); });
+    _sparse = sparse;
+
+    // Index the fragments which have values at each snp, so that consensus changes only touch those
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        for_each_value(frag_idx, [&](const size_t snp_idx, const small_type)
+        {
+            ++_snp_offsets[snp_idx + 1];
+        });
+    }
+    for (size_t snp_idx = 0; snp_idx < _data->snps; ++snp_idx)
+        _snp_offsets[snp_idx + 1] += _snp_offsets[snp_idx];
+
+    _snp_frags.resize(_snp_offsets[_data->snps]);
+    count_container snp_fill(_snp_offsets.begin(), _snp_offsets.end() - 1);
+    for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx) {
+        for_each_value(frag_idx, [&](const size_t snp_idx, const small_type)
+        {
+            _snp_frags[snp_fill[snp_idx]++] = frag_idx;
+        });
+    }
+
+    // With no fragments the IH snps still need complementary haplotypes
+    for (size_t snp_idx = 0; snp_idx < _data->snps; ++snp_idx)
+        consensus(snp_idx, &_counts[4 * snp_idx], _haplo_one[snp_idx], _haplo_two[snp_idx]);
+}
+
+inline void Partition::assign(const size_t frag_idx, const small_type set)
+{
+    const small_type old_set   = _sets[frag_idx];
+
+    if (old_set == set) return;
+
+    for_each_value(frag_idx, [&](const size_t snp_idx, const small_type elem_value)
+    {
+        size_t* counts = &_counts[4 * snp_idx];
+        if (old_set != unassigned) --counts[2 * (old_set - 1) + elem_value];
+        ++counts[2 * (set - 1) + elem_value];
+    });
+
+    // Update the set before the snps so that the fragment is skipped when the snps update mismatches
+    if      (old_set == 1) --_set_one_size;
+    else if (old_set == 2) --_set_two_size;
+    set == 1 ? ++_set_one_size : ++_set_two_size;
+    _sets[frag_idx] = set;
+
+    // The old contribution of the fragment is removed, and added back once it has been recounted
+    _mec_score -= _mismatches[frag_idx];
+    for_each_value(frag_idx, [&](const size_t snp_idx, const small_type) { update_snp(snp_idx, frag_idx); });
+    _mismatches[frag_idx] = conflicts(frag_idx, set);
+    _mec_score += _mismatches[frag_idx];
+}
+
+inline Partition::delta_type Partition::move_delta(const size_t frag_idx) const
+{
+    const small_type old_set   = _sets[frag_idx];
+    const small_type new_set   = old_set == 1 ? 2 : 1;
+    delta_type       delta     = 0;
+    small_type       value_one , value_two;
+
+    for_each_value(frag_idx, [&](const size_t snp_idx, const small_type elem_value)
+    {
+        size_t counts[4] = { _counts[4 * snp_idx]    , _counts[4 * snp_idx + 1],
+                             _counts[4 * snp_idx + 2], _counts[4 * snp_idx + 3] };
+        delta -= static_cast<delta_type>(consensus(snp_idx, counts, value_one, value_two));
+        --counts[2 * (old_set - 1) + elem_value];
+        ++counts[2 * (new_set - 1) + elem_value];
+        delta += static_cast<delta_type>(consensus(snp_idx, counts, value_one, value_two));
+    });
+    return delta;
+}
+
+inline void Partition::move_batch(const std::vector<size_t>& frags)
+{
+    // Snps whose consensus changed -- each snp is only written by the move which covers it
+    std::vector<uint8_t> changed(_data->snps, 0);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, frags.size()), [&](const tbb::blocked_range<size_t>& r)
+    {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const size_t     frag_idx  = frags[i];
+            const small_type old_set   = _sets[frag_idx];
+            const small_type new_set   = old_set == 1 ? 2 : 1;
+
+            for_each_value(frag_idx, [&](const size_t snp_idx, const small_type elem_value)
+            {
+                size_t* counts = &_counts[4 * snp_idx];
+                --counts[2 * (old_set - 1) + elem_value];
+                ++counts[2 * (new_set - 1) + elem_value];
+
+                small_type value_one, value_two;
+                consensus(snp_idx, counts, value_one, value_two);
+                if (value_one != _haplo_one[snp_idx] || value_two != _haplo_two[snp_idx]) {
+                    _haplo_one[snp_idx] = value_one; _haplo_two[snp_idx] = value_two;
+                    changed[snp_idx]    = 1;
+                }
+            });
+            _sets[frag_idx] = new_set;
+        }
+    });
+
+    // The moved fragments and those with an element at a changed snp need to be recounted
+    std::vector<uint8_t> affected(_data->reads, 0);
+    std::vector<size_t>  recount(frags);
+    for (const auto frag_idx : frags) {
+        affected[frag_idx] = 1;
+        _sets[frag_idx] == 2 ? (--_set_one_size, ++_set_two_size) : (++_set_one_size, --_set_two_size);
+    }
+    for (size_t snp_idx = 0; snp_idx < _data->snps; ++snp_idx) {
+        if (!changed[snp_idx]) continue;
+        for (size_t i = _snp_offsets[snp_idx]; i < _snp_offsets[snp_idx + 1]; ++i) {
+            const size_t frag_idx = _snp_frags[i];
+            if (affected[frag_idx] || _sets[frag_idx] == unassigned) continue;
+            affected[frag_idx] = 1;
+            recount.push_back(frag_idx);
+        }
+    }
+
+    _mec_score += tbb::parallel_reduce(tbb::blocked_range<size_t>(0, recount.size()), delta_type(0),
+        [&](const tbb::blocked_range<size_t>& r, delta_type delta)
+        {
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                const size_t frag_idx   = recount[i];
+                const size_t mismatches = conflicts(frag_idx, _sets[frag_idx]);
+                delta += static_cast<delta_type>(mismatches) - static_cast<delta_type>(_mismatches[frag_idx]);
+                _mismatches[frag_idx] = mismatches;
+            }
+            return delta;
+        },
+        std::plus<delta_type>()
+    );
+}
+
+inline size_t Partition::conflicts(const size_t frag_idx, const small_type set) const
+{
+    const small_container& haplotype = set == 1 ? _haplo_one : _haplo_two;
+    size_t                 conflicts = 0;
+
+    for_each_value(frag_idx, [&](const size_t snp_idx, const small_type elem_value)
+    {
+        if (elem_value != haplotype[snp_idx]) ++conflicts;
+    });
+    return conflicts;
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline size_t Partition::consensus(const size_t  snp_idx  , const size_t* counts   ,
+                                   small_type&   value_one, small_type&   value_two) const
+{
+    if (_data->snp_info[snp_idx].type() == IH) {
+        // The haplotypes must be complementary, so choose the cheaper orientation
+        const size_t cost_zero_one = counts[1] + counts[2];
+        const size_t cost_one_zero = counts[0] + counts[3];
+        value_one = cost_zero_one <= cost_one_zero ? 0 : 1;
+        value_two = !value_one;
+        return std::min(cost_zero_one, cost_one_zero);
+    }
+    value_one = counts[0] >= counts[1] ? 0 : 1;
+    value_two = counts[2] >= counts[3] ? 0 : 1;
+    return std::min(counts[0], counts[1]) + std::min(counts[2], counts[3]);
+}
+
+inline void Partition::update_snp(const size_t snp_idx, const size_t frag_idx)
+{
+    small_type value_one, value_two;
+    consensus(snp_idx, &_counts[4 * snp_idx], value_one, value_two);
+
+    const bool one_changed = value_one != _haplo_one[snp_idx];
+    const bool two_changed = value_two != _haplo_two[snp_idx];
+    if (!one_changed && !two_changed) return;
+
+    _haplo_one[snp_idx] = value_one; _haplo_two[snp_idx] = value_two;
+
+    for (size_t i = _snp_offsets[snp_idx]; i < _snp_offsets[snp_idx + 1]; ++i) {
+        const size_t     row_idx = _snp_frags[i];
+        const small_type set     = _sets[row_idx];
+        if (row_idx == frag_idx || set == unassigned) continue;
+        if ((set == 1 && !one_changed) || (set == 2 && !two_changed)) continue;
+
+        const small_type elem_value  = value(row_idx, snp_idx);
+        const small_type haplo_value = set == 1 ? value_one : value_two;
+        if (elem_value == haplo_value) {
+            --_mismatches[row_idx]; --_mec_score;
+        } else {
+            ++_mismatches[row_idx]; ++_mec_score;
+        }
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_PARTITION_HPP
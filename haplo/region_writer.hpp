@@ -0,0 +1,173 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   region_writer.hpp
+/// @brief  Header file for the region writer, which streams the phased regions (sub-blocks) of a block to an
+///         output in order, as soon as each region and all the regions before it are solved
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_REGION_WRITER_HPP
+#define PARAHAPLO_REGION_WRITER_HPP
+
+#include "block.hpp"
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#ifndef REGION_WRITER_BUFFER
+    #define REGION_WRITER_BUFFER    (1 << 20)   // Bytes of output buffered before writing to the sink
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      RegionWriter
+/// @brief      Writes the phased regions of a block to a sink. Solutions can arrive in any order, and are
+///             held in a reorder buffer (keyed by the index of the sub-block) until all the earlier regions
+///             have arrived. Each region is then aligned with the previous one (by swapping its haplotypes,
+///             as merge_haplotype and solve_trivial align a sub-block), written to an output buffer and
+///             released. Trivial regions are solved by the writer when they are reached. Each line of
+///             the output is a region -- its start column and the two haplotypes, tab separated -- and as
+///             a region shares its end column with the start of the next, the last column is only written
+///             for the last region, giving the same haplotypes as merging the regions in order.
+/// @tparam     BlockType   The type of the block which the regions are from
+// ----------------------------------------------------------------------------------------------------------
+template <typename BlockType>
+class RegionWriter {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using block_type                = BlockType;
+    using binary_vector             = BinaryVector<2>;
+    using reorder_buffer            = std::map<size_t, StagedSolution>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    const block_type*   _block;             //!< The block which the regions are from
+    std::ostream*       _sink;              //!< The output the regions are written to
+    reorder_buffer      _pending;           //!< The solutions which have arrived before earlier regions
+    size_t              _next;              //!< The index of the next region to write
+    size_t              _regions;           //!< The number of regions in the block
+    uint8_t             _previous;          //!< The value the last region left at the start of the next
+    std::string         _buffer;            //!< The output which has not been written to the sink
+    binary_vector       _haplo_one;         //!< The first haplotype of the region being written
+    binary_vector       _haplo_two;         //!< The second haplotype of the region being written
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  block   The (parsed and split) block which the regions are from
+    /// @param[in]  sink    The output to write the regions to (a file, or std::cout)
+    // ------------------------------------------------------------------------------------------------------
+    RegionWriter(const block_type& block, std::ostream& sink);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- writes any buffered output
+    // ------------------------------------------------------------------------------------------------------
+    ~RegionWriter() { flush(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds the solution of a (non trivial) region, and writes all the regions which are then
+    ///             complete -- not safe to call concurrently
+    /// @param[in]  i           The index of the sub-block
+    /// @param[in]  solution    The solution of the sub-block, from Block::staged_solution
+    // ------------------------------------------------------------------------------------------------------
+    void push(const size_t i, StagedSolution&& solution);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the buffered output to the sink
+    // ------------------------------------------------------------------------------------------------------
+    void flush();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of regions which have been written
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t written() const { return _next; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of solutions waiting in the reorder buffer
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t pending() const { return _pending.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if all the regions have been written
+    // ------------------------------------------------------------------------------------------------------
+    inline bool complete() const { return _next == _regions; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the regions from the next one while they are available (solved, or trivial)
+    // ------------------------------------------------------------------------------------------------------
+    void drain();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Aligns a region and appends it to the output buffer
+    /// @param[in]  solution    The solution of the next region
+    // ------------------------------------------------------------------------------------------------------
+    void write(const StagedSolution& solution);
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename BlockType>
+RegionWriter<BlockType>::RegionWriter(const block_type& block, std::ostream& sink)
+: _block(&block), _sink(&sink), _next(0), _regions(block.num_subblocks() > 0 ? block.num_subblocks() - 1 : 0),
+  _previous(0)
+{
+    _buffer.reserve(REGION_WRITER_BUFFER);
+    drain();
+}
+
+template <typename BlockType>
+void RegionWriter<BlockType>::push(const size_t i, StagedSolution&& solution)
+{
+    if (i < _next || i >= _regions) return;
+    _pending[i] = std::move(solution);
+    drain();
+}
+
+template <typename BlockType>
+void RegionWriter<BlockType>::flush()
+{
+    if (_buffer.empty()) return;
+    _sink->write(_buffer.data(), _buffer.size());
+    _sink->flush();
+    _buffer.clear();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename BlockType>
+void RegionWriter<BlockType>::drain()
+{
+    while (_next < _regions) {
+        if (_block->is_trivial(_next)) {
+            StagedSolution solution;
+            _block->trivial_solution(_next, solution);
+            write(solution);
+        } else {
+            const auto solution = _pending.find(_next);
+            if (solution == _pending.end()) break;
+            write(solution->second);
+            _pending.erase(solution);
+        }
+    }
+    if (complete() || _buffer.size() >= REGION_WRITER_BUFFER) flush();
+}
+
+template <typename BlockType>
+void RegionWriter<BlockType>::write(const StagedSolution& solution)
+{
+    _previous = _block->aligned_region(_next, solution, _previous, _haplo_one, _haplo_two);
+
+    // The end column is the start of the next region, which writes it
+    const size_t columns = _haplo_one.size() - (++_next < _regions ? 1 : 0);
+    if (columns == 0) return;
+
+    _buffer += std::to_string(_block->subblock(_next - 1));
+    _buffer += '\t';
+    for (size_t i = 0; i < columns; ++i) _buffer += static_cast<char>('0' + _haplo_one.get(i));
+    _buffer += '\t';
+    for (size_t i = 0; i < columns; ++i) _buffer += static_cast<char>('0' + _haplo_two.get(i));
+    _buffer += '\n';
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_REGION_WRITER_HPP
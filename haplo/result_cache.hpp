@@ -0,0 +1,270 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   result_cache.hpp
+/// @brief  Header file for the result cache, which stores the solutions of sub-blocks on disk, keyed by a
+///         hash of their content, so that sub-blocks which are unchanged between runs aren't solved again
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_RESULT_CACHE_HPP
+#define PARAHAPLO_RESULT_CACHE_HPP
+
+#include "small_containers.h"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <tbb/tbb.h>
+#include <tbb/spin_mutex.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+namespace haplo {
+
+namespace io = boost::iostreams;
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ResultCache
+/// @brief      A persistent cache of the solutions of sub-blocks. The key of a sub-block is a hash of its
+///             canonical content -- the span and elements of each read and the type of each column -- and
+///             of the solver settings, which the dispatcher mixes in. The cache file is a magic word and
+///             then fixed layout records of 64 bit words: the key, the MEC score, the size of the sub-block
+///             and the bits of the two haplotypes. The file is memory mapped when the cache is opened, and
+///             new records are appended to it, so a hit is a lookup in the mapped file.
+// ----------------------------------------------------------------------------------------------------------
+class ResultCache {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using key_type          = uint64_t;
+    using word_type         = uint64_t;
+    using binary_vector     = BinaryVector<2>;
+    using word_container    = std::vector<word_type>;
+    using index_map         = std::unordered_map<key_type, const word_type*>;
+    using added_map         = std::unordered_map<key_type, word_container>;
+    using atomic_type       = tbb::atomic<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr word_type  magic           = 0x3130484341435048ULL;    // "PHCACH01"
+    static constexpr size_t     header_words    = 4;                        // Key, MEC, snps and reads
+private:
+    std::string             _filename;      //!< The name of the cache file
+    io::mapped_file_source  _mapped;        //!< The records in the file when it was opened
+    index_map               _index;         //!< The record of each key in the mapped file
+    added_map               _added;         //!< The records added since the file was opened
+    std::ofstream           _file;          //!< The file the added records are appended to
+    tbb::spin_mutex         _mutex;         //!< Protects the added records and the file
+    atomic_type             _hits;          //!< The number of lookups which found a solution
+    atomic_type             _misses;        //!< The number of lookups which did not
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- opens the cache file (creating it if it doesn't exist or is empty) and
+    ///             indexes it. Throws a runtime_error if the file is not a cache, so it is never truncated
+    /// @param[in]  filename    The name of the cache file
+    // ------------------------------------------------------------------------------------------------------
+    explicit ResultCache(const std::string& filename);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Mixes the bits of a value (splitmix64), to combine values into a key
+    /// @param[in]  value   The value to mix
+    // ------------------------------------------------------------------------------------------------------
+    static inline key_type mix(key_type value)
+    {
+        value += 0x9e3779b97f4a7c15ULL;
+        value  = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value  = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Combines a value into a key
+    /// @param[in]  key     The key to combine the value into
+    /// @param[in]  value   The value to combine
+    // ------------------------------------------------------------------------------------------------------
+    static inline key_type combine(const key_type key, const key_type value) { return mix(key ^ mix(value)); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the key of the content of a sub-block
+    /// @param[in]  sub_block       The sub-block
+    /// @tparam     SubBlockType    The type of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    template <typename SubBlockType>
+    static key_type content_key(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the solution for a key -- safe to call concurrently
+    /// @param[in]  key         The key of the sub-block
+    /// @param[in]  snps        The number of snps of the sub-block (checked against the record)
+    /// @param[in]  reads       The number of reads of the sub-block (checked against the record)
+    /// @param[out] haplo_one   The first haplotype of the solution
+    /// @param[out] haplo_two   The second haplotype of the solution
+    /// @param[out] mec_score   The MEC score of the solution
+    /// @return     True if the solution was found
+    // ------------------------------------------------------------------------------------------------------
+    bool find(const key_type key      , const size_t   snps     , const size_t reads,
+              binary_vector& haplo_one, binary_vector& haplo_two, size_t&      mec_score);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds the solution for a key, and appends it to the file -- safe to call concurrently
+    /// @param[in]  key         The key of the sub-block
+    /// @param[in]  reads       The number of reads of the sub-block
+    /// @param[in]  haplo_one   The first haplotype of the solution
+    /// @param[in]  haplo_two   The second haplotype of the solution
+    /// @param[in]  mec_score   The MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    void insert(const key_type       key      , const size_t         reads    ,
+                const binary_vector& haplo_one, const binary_vector& haplo_two, const size_t mec_score);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the added records to the file
+    // ------------------------------------------------------------------------------------------------------
+    inline void flush() { tbb::spin_mutex::scoped_lock lock(_mutex); _file.flush(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of solutions in the cache
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _index.size() + _added.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of lookups which found a solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t hits() const { return _hits; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of lookups which did not find a solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t misses() const { return _misses; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of words of a record
+    /// @param[in]  snps    The number of snps of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t record_words(const size_t snps) { return header_words + 2 * ((snps + 63) / 64); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the solution from a record
+    /// @param[in]  record      The words of the record
+    /// @param[out] haplo_one   The first haplotype of the solution
+    /// @param[out] haplo_two   The second haplotype of the solution
+    /// @param[out] mec_score   The MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    static void read_record(const word_type* record   , binary_vector& haplo_one,
+                            binary_vector&   haplo_two, size_t&        mec_score);
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline ResultCache::ResultCache(const std::string& filename)
+: _filename(filename), _hits(0), _misses(0)
+{
+    struct stat info;
+    if (stat(_filename.c_str(), &info) == 0 && info.st_size > 0) {
+        // Any other file is left alone, rather than being truncated
+        if (info.st_size < static_cast<off_t>(sizeof(word_type)))
+            throw std::runtime_error("File " + _filename + " is not a result cache =(!\n");
+        _mapped.open(_filename);
+        const word_type* words = reinterpret_cast<const word_type*>(_mapped.data());
+        const size_t     total = _mapped.size() / sizeof(word_type);
+        if (words[0] != magic) throw std::runtime_error("File " + _filename + " is not a result cache =(!\n");
+
+        // A record which was only partly written (the last, if a run stopped) is ignored
+        for (size_t word = 1; word + header_words <= total; ) {
+            const size_t words_of_record = record_words(words[word + 2]);
+            if (word + words_of_record > total) break;
+            _index.emplace(words[word], words + word);
+            word += words_of_record;
+        }
+        _file.open(_filename, std::ios::binary | std::ios::app);
+    } else {
+        // The file is missing or empty, so start a new one
+        _file.open(_filename, std::ios::binary | std::ios::trunc);
+        const word_type header = magic;
+        _file.write(reinterpret_cast<const char*>(&header), sizeof(word_type));
+    }
+}
+
+template <typename SubBlockType>
+ResultCache::key_type ResultCache::content_key(SubBlockType& sub_block)
+{
+    const auto& read_info = sub_block.read_info();
+    const auto  snp_info  = sub_block.snp_info();
+    key_type    key       = combine(sub_block.reads(), snp_info.size());
+
+    for (size_t snp_idx = 0; snp_idx < snp_info.size(); ++snp_idx)
+        key = combine(key, snp_info[snp_idx].type());
+
+    // Each read is its span and its elements, packed 32 to a word
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read = read_info[read_idx];
+        key = combine(key, (static_cast<key_type>(read.start_index()) << 32) | read.end_index());
+
+        word_type elements = 0;
+        for (size_t snp_idx = read.start_index(); snp_idx <= read.end_index(); ++snp_idx) {
+            elements = (elements << 2) | (sub_block(read_idx, snp_idx) & 0x03);
+            if ((snp_idx - read.start_index()) % 32 == 31) { key = combine(key, elements); elements = 0; }
+        }
+        key = combine(key, elements);
+    }
+    return key;
+}
+
+inline bool ResultCache::find(const key_type key      , const size_t   snps     , const size_t reads,
+                              binary_vector& haplo_one, binary_vector& haplo_two, size_t&      mec_score)
+{
+    const word_type* record = nullptr;
+    const auto       mapped = _index.find(key);
+    if (mapped != _index.end()) {
+        record = mapped->second;
+    } else {
+        tbb::spin_mutex::scoped_lock lock(_mutex);
+        const auto added = _added.find(key);
+        if (added != _added.end()) record = added->second.data();
+    }
+
+    // The sizes guard against the (unlikely) collision of keys of different sizes
+    if (record == nullptr || record[2] != snps || record[3] != reads) {
+        ++_misses;
+        return false;
+    }
+    read_record(record, haplo_one, haplo_two, mec_score);
+    ++_hits;
+    return true;
+}
+
+inline void ResultCache::insert(const key_type       key      , const size_t         reads    ,
+                                const binary_vector& haplo_one, const binary_vector& haplo_two,
+                                const size_t         mec_score)
+{
+    const size_t   snps = haplo_one.size();
+    word_container record(record_words(snps), 0);
+    record[0] = key; record[1] = mec_score; record[2] = snps; record[3] = reads;
+
+    word_type* bits = record.data() + header_words;
+    for (size_t i = 0; i < snps; ++i) {
+        bits[i / 64]                     |= static_cast<word_type>(haplo_one.get(i) & 1) << (i % 64);
+        bits[(snps + 63) / 64 + i / 64]  |= static_cast<word_type>(haplo_two.get(i) & 1) << (i % 64);
+    }
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+    if (_index.find(key) != _index.end() || _added.find(key) != _added.end()) return;
+    _file.write(reinterpret_cast<const char*>(record.data()), record.size() * sizeof(word_type));
+    _added.emplace(key, std::move(record));
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline void ResultCache::read_record(const word_type* record   , binary_vector& haplo_one,
+                                     binary_vector&   haplo_two, size_t&        mec_score)
+{
+    const size_t     snps = record[2];
+    const word_type* bits = record + header_words;
+    mec_score = record[1];
+    haplo_one.resize(snps); haplo_two.resize(snps);
+    for (size_t i = 0; i < snps; ++i) {
+        haplo_one.set(i, (bits[i / 64] >> (i % 64)) & 1);
+        haplo_two.set(i, (bits[(snps + 63) / 64 + i / 64] >> (i % 64)) & 1);
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_RESULT_CACHE_HPP
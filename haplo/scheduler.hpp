@@ -0,0 +1,150 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   scheduler.hpp
+/// @brief  Header file for the scheduler, which orders the sub-blocks of a block into tasks by their
+///         estimated cost, so that the few large sub-blocks don't leave a long tail at the end of a run
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SCHEDULER_HPP
+#define PARAHAPLO_SCHEDULER_HPP
+
+#include "block.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#ifndef SCHEDULER_BATCH_COST
+    #define SCHEDULER_BATCH_COST    1e5     // Sub-blocks are batched into tasks of at most this cost
+#endif
+#ifndef SCHEDULER_BATCH_SIZE
+    #define SCHEDULER_BATCH_SIZE    32      // The most sub-blocks in a batched task
+#endif
+
+namespace haplo {
+namespace schedule {
+
+static constexpr uint8_t in_order       = 0;    // The sub-blocks in column order
+static constexpr uint8_t largest_first  = 1;    // The sub-blocks with the largest estimated cost first
+
+}               // End namespace schedule
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     ScheduleReport
+/// @brief      How close a run came to the ideal makespan -- the larger of the total work shared evenly
+///             between the workers and the longest task, which no schedule can do better than
+// ----------------------------------------------------------------------------------------------------------
+struct ScheduleReport {
+    size_t  tasks       = 0;                //!< The number of tasks
+    size_t  batched     = 0;                //!< The number of sub-blocks in tasks with more than one
+    size_t  workers     = 0;                //!< The number of tasks which can run at once
+    double  work_ns     = 0.0;              //!< The total time of all the tasks
+    double  longest_ns  = 0.0;              //!< The time of the longest task
+    double  makespan_ns = 0.0;              //!< The time from the first task starting to the last finishing
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the ideal makespan -- the lower bound on the makespan of any schedule of the tasks
+    // ------------------------------------------------------------------------------------------------------
+    inline double ideal_ns() const
+    {
+        return workers > 0 ? std::max(work_ns / workers, longest_ns) : work_ns;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the ideal makespan as a fraction of the makespan (1 is an ideal schedule)
+    // ------------------------------------------------------------------------------------------------------
+    inline double efficiency() const { return makespan_ns > 0.0 ? ideal_ns() / makespan_ns : 1.0; }
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Scheduler
+/// @brief      Groups the non trivial sub-blocks of a block into tasks. The cost of each sub-block is
+///             estimated from its shape (reads x snps x coverage) before it is created. Sub-blocks are
+///             ordered largest first (the longest processing time rule), so the large sub-blocks start
+///             while there is other work to overlap them with, and the small sub-blocks at the end are
+///             batched into tasks to amortise the overhead of a task for each.
+// ----------------------------------------------------------------------------------------------------------
+class Scheduler {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using index_container   = std::vector<size_t>;
+    using task_container    = std::vector<index_container>;
+    using cost_container    = std::vector<double>;
+private:
+    task_container  _tasks;             //!< The sub-blocks of each task, in the order to run them
+    cost_container  _costs;             //!< The estimated cost of each task
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- schedules the non trivial sub-blocks of a block
+    /// @param[in]  block       The (parsed and split) block to schedule
+    /// @param[in]  order       The order of the sub-blocks (see schedule::)
+    /// @param[in]  batch_cost  The most estimated cost of a batched task (0 to not batch)
+    /// @param[in]  batch_size  The most sub-blocks in a batched task
+    /// @param[in]  finished    The sub-blocks which are already solved and are left out (nullptr for none)
+    /// @tparam     BlockType   The type of the block
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BlockType>
+    explicit Scheduler(const BlockType&         block                           ,
+                       const uint8_t            order      = schedule::largest_first,
+                       const double             batch_cost = SCHEDULER_BATCH_COST   ,
+                       const size_t             batch_size = SCHEDULER_BATCH_SIZE   ,
+                       const std::vector<bool>* finished   = nullptr                );
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Estimates the cost of solving a sub-block from its shape
+    /// @param[in]  shape   The shape of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    static inline double estimate(const SubBlockShape& shape)
+    {
+        return static_cast<double>(shape.reads) * static_cast<double>(shape.snps) * shape.coverage();
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the tasks, in the order to run them
+    // ------------------------------------------------------------------------------------------------------
+    inline const task_container& tasks() const { return _tasks; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the estimated cost of a task
+    /// @param[in]  i   The index of the task
+    // ------------------------------------------------------------------------------------------------------
+    inline double cost(const size_t i) const { return _costs[i]; }
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename BlockType>
+Scheduler::Scheduler(const BlockType& block    , const uint8_t            order   , const double batch_cost,
+                     const size_t     batch_size, const std::vector<bool>* finished)
+{
+    const size_t    subblocks = block.num_subblocks() > 0 ? block.num_subblocks() - 1 : 0;
+    index_container pending;
+    cost_container  costs(subblocks, 0.0);
+    for (size_t i = 0; i < subblocks; ++i) {
+        if (block.is_trivial(i) || (finished != nullptr && (*finished)[i])) continue;
+        pending.push_back(i);
+        costs[i] = estimate(block.subblock_shape(i));
+    }
+
+    // Ties keep column order, so that the schedule is deterministic
+    if (order == schedule::largest_first) {
+        std::stable_sort(pending.begin(), pending.end(),
+            [&](const size_t a, const size_t b) { return costs[a] > costs[b]; });
+    }
+
+    // Consecutive cheap sub-blocks share a task until the task reaches the batch cost or size
+    for (const auto i : pending) {
+        const bool batch = !_tasks.empty() && costs[i] < batch_cost && _tasks.back().size() < batch_size &&
+                           _costs.back() + costs[i] <= batch_cost;
+        if (!batch) {
+            _tasks.emplace_back();
+            _costs.push_back(0.0);
+        }
+        _tasks.back().push_back(i);
+        _costs.back() += costs[i];
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SCHEDULER_HPP
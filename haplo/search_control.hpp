@@ -0,0 +1,153 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   search_control.hpp
+/// @brief  Header file for the search control class, which bounds the refinement of a solution by a number
+///         of iterations, a wall clock budget, a number of non-improving restarts, a target MEC score and a
+///         lower bound on the MEC score
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SEARCH_CONTROL_HPP
+#define PARAHAPLO_SEARCH_CONTROL_HPP
+
+#include <chrono>
+#include <stdint.h>
+
+#ifndef ITERS
+    #define ITERS       6000        // Number of iterations before ensuring termination
+#endif
+
+namespace haplo {
+namespace stop {
+
+static constexpr uint8_t none       = 0;        // The search has not stopped
+static constexpr uint8_t converged  = 1;        // Too many restarts without improving the best solution
+static constexpr uint8_t iterations = 2;        // The iteration limit was reached
+static constexpr uint8_t deadline   = 3;        // The time budget was used
+static constexpr uint8_t target     = 4;        // The target MEC score was reached
+static constexpr uint8_t optimal    = 5;        // The MEC score reached its lower bound
+
+}               // End namespace stop
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      SearchControl
+/// @brief      Determines when the refinement of a solution should stop. The refinement always keeps the
+///             best solution found so far, so stopping early (at the deadline for example) gives a valid,
+///             if not fully refined, solution. The defaults refine until the first local optimum.
+// ----------------------------------------------------------------------------------------------------------
+class SearchControl {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using clock_type        = std::chrono::steady_clock;
+    using time_point_type   = clock_type::time_point;
+    using duration_type     = std::chrono::microseconds;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    duration_type       _time_budget;           //!< The time allowed for a search (zero is unbounded)
+    size_t              _max_iters;             //!< The maximum number of refinement iterations
+    size_t              _max_stalled_iters;     //!< The maximum number of restarts which don't improve
+    size_t              _target_mec;            //!< The MEC score which is good enough to stop at
+    size_t              _lower_bound;           //!< A lower bound on the MEC score, which is optimal
+    time_point_type     _start_time;            //!< When the search started
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the default limits
+    // ------------------------------------------------------------------------------------------------------
+    SearchControl() noexcept
+    : _time_budget(0), _max_iters(ITERS), _max_stalled_iters(0), _target_mec(0), _lower_bound(0),
+      _start_time(clock_type::now()) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the time allowed for each search, measured from when the search starts
+    /// @param[in]  budget      The time budget, zero for no time limit
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_time_budget(const duration_type budget) { _time_budget = budget; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the maximum number of refinement iterations
+    /// @param[in]  max_iters   The maximum number of iterations
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_max_iters(const size_t max_iters) { _max_iters = max_iters; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the number of consecutive restarts (from a perturbation of the best solution) which
+    ///             may fail to improve the best solution before the search is considered converged
+    /// @param[in]  max_stalled_iters   The maximum number of non-improving restarts, zero for none
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_max_stalled_iters(const size_t max_stalled_iters)
+    {
+        _max_stalled_iters = max_stalled_iters;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the MEC score at which the search stops
+    /// @param[in]  target_mec  The target MEC score
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_target_mec(const size_t target_mec) { _target_mec = target_mec; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets a proven lower bound on the MEC score, so that the search stops once it is reached
+    /// @param[in]  lower_bound The lower bound on the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_lower_bound(const size_t lower_bound) { _lower_bound = lower_bound; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the time budget
+    // ------------------------------------------------------------------------------------------------------
+    inline duration_type time_budget() const { return _time_budget; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the maximum number of refinement iterations
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_iters() const { return _max_iters; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the maximum number of non-improving restarts
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_stalled_iters() const { return _max_stalled_iters; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the target MEC score
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t target_mec() const { return _target_mec; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the lower bound on the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t lower_bound() const { return _lower_bound; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Starts the clock for the time budget
+    // ------------------------------------------------------------------------------------------------------
+    inline void start() { _start_time = clock_type::now(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the time since the search started
+    // ------------------------------------------------------------------------------------------------------
+    inline duration_type elapsed() const
+    {
+        return std::chrono::duration_cast<duration_type>(clock_type::now() - _start_time);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines if the search should stop before the next iteration
+    /// @param[in]  iters       The number of iterations performed
+    /// @param[in]  mec_score   The MEC score of the best solution so far
+    /// @return     The reason to stop, or stop::none if the search should continue
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t check(const size_t iters, const size_t mec_score) const
+    {
+        if (mec_score <= _target_mec)                                       return stop::target;
+        if (mec_score <= _lower_bound)                                      return stop::optimal;
+        if (iters >= _max_iters)                                            return stop::iterations;
+        if (_time_budget != duration_type(0) && elapsed() >= _time_budget)  return stop::deadline;
+        return stop::none;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines if the search has converged, at a local optimum
+    /// @param[in]  stalled_iters   The number of restarts since the best solution last improved
+    // ------------------------------------------------------------------------------------------------------
+    inline bool converged(const size_t stalled_iters) const { return stalled_iters >= _max_stalled_iters; }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SEARCH_CONTROL_HPP
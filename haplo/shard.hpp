@@ -0,0 +1,269 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   shard.hpp
+/// @brief  Header file for the sharder, which cuts an input into shards at splittable columns so that the
+///         shards can be phased by separate processes (on separate machines), and merges the haplotypes
+///         of the shards back together
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SHARD_HPP
+#define PARAHAPLO_SHARD_HPP
+
+#include "block.hpp"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef SHARD_MANIFEST
+    #define SHARD_MANIFEST  "shards.tsv"    // The name of the manifest of the shards in the shard directory
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @struct     Shard
+/// @brief      A contiguous range of the columns of an input, and the reads in it, which is phased alone
+// ----------------------------------------------------------------------------------------------------------
+struct Shard {
+    size_t      index       = 0;            //!< The index of the shard
+    size_t      start_col   = 0;            //!< The column of the input the shard starts at (its offset)
+    size_t      end_col     = 0;            //!< The last column of the input in the shard
+    size_t      reads       = 0;            //!< The number of reads in the shard
+    size_t      elements    = 0;            //!< The number of elements in the shard
+    std::string input;                      //!< The input file of the shard (with columns from 0)
+    std::string result;                     //!< The file the haplotypes of the shard are written to
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Sharder
+/// @brief      Cuts an input into shards, and merges their haplotypes. The cuts are made at splittable
+///             columns (the boundaries of the sub-blocks), which no read crosses, chosen so that the shards
+///             have about the same number of elements. Each shard is written as an input file, with its
+///             columns offset to start at 0, and the shards are listed in a manifest (index, start and end
+///             columns, reads, elements and the files) in the shard directory. Each shard is phased by a
+///             worker, which writes the two haplotypes of the shard to its result file. Neighbouring shards
+///             share the cut column, so when the results are merged each shard is aligned with the previous
+///             one at that column -- as merge_haplotype aligns sub-blocks, by swapping the haplotypes,
+///             since the homozygous columns of a shard are already resolved.
+// ----------------------------------------------------------------------------------------------------------
+class Sharder {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using binary_vector     = BinaryVector<2>;
+    using shard_container   = std::vector<Shard>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    std::string         _directory;         //!< The directory of the shards
+    shard_container     _shards;            //!< The shards, in column order
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- reads the manifest of the shards in a directory, if there is one
+    /// @param[in]  directory   The directory of the shards
+    // ------------------------------------------------------------------------------------------------------
+    explicit Sharder(const std::string& directory);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Cuts an input into shards, and writes the shards and the manifest to the directory --
+    ///             throws if the input has empty columns, or if the directory can't be made or a shard or
+    ///             the manifest can't be written
+    /// @param[in]  block       The (parsed and split) block of the input
+    /// @param[in]  input       The input file of the block
+    /// @param[in]  shards      The number of shards to cut the input into (fewer if it has fewer cuts)
+    /// @tparam     BlockType   The type of the block
+    /// @return     The number of shards
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BlockType>
+    size_t split(const BlockType& block, const std::string& input, const size_t shards);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges the results of the shards -- throws if there are no shards (the manifest is
+    ///             missing or empty), or if a result is missing or doesn't match its shard
+    /// @param[out] haplo_one   The first haplotype of the input
+    /// @param[out] haplo_two   The second haplotype of the input
+    // ------------------------------------------------------------------------------------------------------
+    void merge(binary_vector& haplo_one, binary_vector& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the shards
+    // ------------------------------------------------------------------------------------------------------
+    inline const shard_container& shards() const { return _shards; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the name of the manifest of the shards
+    // ------------------------------------------------------------------------------------------------------
+    inline std::string manifest() const { return _directory + "/" + SHARD_MANIFEST; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Writes the manifest of the shards -- throws if it can't be written
+    // ------------------------------------------------------------------------------------------------------
+    void write_manifest() const;
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline Sharder::Sharder(const std::string& directory)
+: _directory(directory)
+{
+    std::ifstream manifest_file(manifest());
+    std::string   line;
+    while (std::getline(manifest_file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        Shard              shard;
+        if (fields >> shard.index >> shard.start_col >> shard.end_col >> shard.reads >> shard.elements
+                   >> shard.input >> shard.result) {
+            _shards.push_back(shard);
+        }
+    }
+}
+
+template <typename BlockType>
+size_t Sharder::split(const BlockType& block, const std::string& input, const size_t shards)
+{
+    // The columns the reads span -- the block only has the columns with values, so a worker can only phase
+    // a shard if none of its columns are empty
+    size_t cols = 0;
+    for (size_t read_idx = 0; read_idx < block.reads(); ++read_idx) {
+        const auto& read = block.read_info(read_idx);
+        if (read.start_index() > read.end_index())
+            throw std::runtime_error("Invalid read " + std::to_string(read_idx) + " in " + input + "\n");
+        cols = std::max(cols, read.end_index() + 1);
+    }
+    _shards.clear();
+    if (cols == 0) return 0;
+    if (block.haplo_one().size() != cols) {
+        const size_t empty = cols - block.haplo_one().size();
+        throw std::runtime_error("Can't shard " + input + " : " + std::to_string(empty) + " of its " +
+                                 std::to_string(cols) + " columns have no values\n");
+    }
+
+    // The elements of the reads which start before each column, and the furthest a read before it ends
+    std::vector<size_t> elements(cols + 1, 0), reach(cols + 1, 0);
+    for (size_t read_idx = 0; read_idx < block.reads(); ++read_idx) {
+        const auto& read = block.read_info(read_idx);
+        elements[read.start_index() + 1] += read.length();
+        reach[read.start_index() + 1]     = std::max(reach[read.start_index() + 1], read.end_index());
+    }
+    for (size_t col_idx = 1; col_idx <= cols; ++col_idx) {
+        elements[col_idx] += elements[col_idx - 1];
+        reach[col_idx]     = std::max(reach[col_idx], reach[col_idx - 1]);
+    }
+
+    // Cut at the first sub-block boundary past each share of the elements which no earlier read crosses
+    std::vector<size_t> cuts(1, 0);
+    const size_t        target = elements[cols] / std::max(shards, size_t(1)) + 1;
+    for (size_t i = 1; i + 1 < block.num_subblocks() && cuts.size() < shards; ++i) {
+        const size_t col_idx = block.subblock(i);
+        if (reach[col_idx] <= col_idx && elements[col_idx] - elements[cuts.back()] >= target)
+            cuts.push_back(col_idx);
+    }
+
+    // Each read is in the shard it starts in, and a shard starts at the first column of its reads (which is
+    // the cut column, unless only reads of the previous shard have the cut column)
+    std::vector<size_t> shard_of(block.reads(), 0);
+    _shards.resize(cuts.size());
+    for (size_t k = 0; k < cuts.size(); ++k) {
+        _shards[k].index     = k;
+        _shards[k].start_col = cols;
+        _shards[k].input     = _directory + "/shard_" + std::to_string(k) + ".txt";
+        _shards[k].result    = _directory + "/shard_" + std::to_string(k) + ".haplo";
+    }
+    for (size_t read_idx = 0; read_idx < block.reads(); ++read_idx) {
+        const auto& read = block.read_info(read_idx);
+        const auto  next = std::upper_bound(cuts.begin(), cuts.end(), read.start_index());
+        shard_of[read_idx] = (next - cuts.begin()) - 1;
+
+        auto& shard = _shards[shard_of[read_idx]];
+        shard.start_col = std::min(shard.start_col, read.start_index());
+        shard.end_col   = std::max(shard.end_col, read.end_index());
+        shard.elements += read.length();
+        ++shard.reads;
+    }
+
+    // The reads of the input are in the order of the rows of the block
+    std::ifstream input_file(input);
+    if (!input_file) throw std::runtime_error("Could not open input file " + input + "\n");
+    if (mkdir(_directory.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("Could not create shard directory " + _directory + "\n");
+    std::vector<std::ofstream> shard_files;
+    for (const auto& shard : _shards) {
+        shard_files.emplace_back(shard.input);
+        if (!shard_files.back()) throw std::runtime_error("Could not open shard file " + shard.input + "\n");
+    }
+
+    std::string line;
+    for (size_t read_idx = 0; read_idx < block.reads() && std::getline(input_file, line); ) {
+        if (line.empty()) continue;
+        const auto&        shard = _shards[shard_of[read_idx++]];
+        std::istringstream fields(line);
+        size_t             start, end;
+        std::string        data;
+        fields >> start >> end >> data;
+        shard_files[shard.index] << start - shard.start_col << ' ' << end - shard.start_col << ' ' << data
+                                 << '\n';
+    }
+    for (const auto& shard : _shards) {
+        if (!shard_files[shard.index].flush())
+            throw std::runtime_error("Could not write shard file " + shard.input + "\n");
+    }
+    write_manifest();
+    return _shards.size();
+}
+
+inline void Sharder::merge(binary_vector& haplo_one, binary_vector& haplo_two) const
+{
+    if (_shards.empty())
+        throw std::runtime_error("No shards in manifest " + manifest() + "\n");
+
+    size_t cols = 0;
+    for (const auto& shard : _shards) cols = std::max(cols, shard.end_col + 1);
+    haplo_one.resize(cols); haplo_two.resize(cols);
+
+    size_t merged = 0;                      // The columns which are merged
+    for (const auto& shard : _shards) {
+        std::ifstream result(shard.result);
+        std::string   shard_one, shard_two;
+        if (!(result >> shard_one >> shard_two) || shard_one.size() != shard_two.size() ||
+            shard.start_col + shard_one.size() != shard.end_col + 1) {
+            throw std::runtime_error("Missing or invalid result for shard " + std::to_string(shard.index) +
+                                     " : " + shard.result + "\n");
+        }
+
+        // The shard is aligned with the previous shard at the cut column, unless either is homozygous there
+        // (and then the heterozygous values are kept)
+        const size_t start   = shard.start_col;
+        const bool   shared  = start < merged;
+        const bool   het     = shared && shard_one[0] != shard_two[0];
+        const bool   prev    = shared && haplo_one.get(start) != haplo_two.get(start);
+        const bool   swapped = het && prev && (shard_one[0] - '0') != haplo_one.get(start);
+        for (size_t i = (shared && prev && !het) ? 1 : 0; i < shard_one.size(); ++i) {
+            haplo_one.set(start + i, (swapped ? shard_two[i] : shard_one[i]) - '0');
+            haplo_two.set(start + i, (swapped ? shard_one[i] : shard_two[i]) - '0');
+        }
+        merged = std::max(merged, shard.end_col + 1);
+    }
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline void Sharder::write_manifest() const
+{
+    std::ofstream manifest_file(manifest());
+    manifest_file << "# index\tstart_col\tend_col\treads\telements\tinput\tresult\n";
+    for (const auto& shard : _shards) {
+        manifest_file << shard.index    << '\t' << shard.start_col << '\t' << shard.end_col  << '\t'
+                      << shard.reads    << '\t' << shard.elements  << '\t' << shard.input    << '\t'
+                      << shard.result   << '\n';
+    }
+    if (!manifest_file.flush()) throw std::runtime_error("Could not write manifest " + manifest() + "\n");
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SHARD_HPP
@@ -0,0 +1,165 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   sketch.hpp
+/// @brief  Header file for the fragment sketches, which find the candidate neighbours of each fragment with
+///         locality sensitive hashing of MinHash sketches, rather than by comparing all pairs of fragments
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SKETCH_HPP
+#define PARAHAPLO_SKETCH_HPP
+
+#include "data.h"
+
+#include <tbb/tbb.h>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SKETCH_HASHES
+    #define SKETCH_HASHES       16      // The number of min-hashes in the sketch of each fragment
+#endif
+#ifndef SKETCH_ROWS
+    #define SKETCH_ROWS         2       // The number of min-hashes in each band of the sketch
+#endif
+#ifndef SKETCH_MAX_BUCKET
+    #define SKETCH_MAX_BUCKET   64      // The most candidates which are taken from any one bucket
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      FragmentSketches
+/// @brief      A MinHash sketch of the (snp, allele) pairs of each fragment, banded for locality sensitive
+///             hashing. Fragments whose sketches are equal in any band are candidate neighbours. Fragments
+///             from opposite haplotypes have complementary alleles (and are just as informative), so the
+///             sketch of the complement of each fragment is also looked up. Buckets can be large (when
+///             many reads are duplicates, say), so at most SKETCH_MAX_BUCKET candidates are taken from each
+///             one -- the fragments next to the fragment in the bucket -- which keeps the candidates of a
+///             fragment bounded without splitting the fragments of a large bucket into separate groups.
+// ----------------------------------------------------------------------------------------------------------
+class FragmentSketches {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using data_type             = Data;
+    using hash_type             = uint64_t;
+    using hash_container        = std::vector<hash_type>;
+    using index_container       = std::vector<size_t>;
+    using bucket_map            = std::unordered_map<hash_type, index_container>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t hashes      = SKETCH_HASHES;
+    static constexpr size_t rows        = SKETCH_ROWS;
+    static constexpr size_t bands       = SKETCH_HASHES / SKETCH_ROWS;
+    static constexpr size_t max_bucket  = SKETCH_MAX_BUCKET;
+private:
+    const data_type*        _data;              //!< The data of the sub-block
+    hash_type               _seed;              //!< The seed of the hash functions
+    hash_container          _sketches;          //!< The band hashes of each fragment
+    hash_container          _complements;       //!< The band hashes of the complement of each fragment
+    std::vector<bucket_map> _buckets;           //!< The fragments with each hash, for each band
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sketches the fragments and puts them in the buckets of each band
+    /// @param[in]  data    The data of the sub-block
+    /// @param[in]  seed    The seed for the hash functions
+    // ------------------------------------------------------------------------------------------------------
+    explicit FragmentSketches(const data_type& data, const hash_type seed = 0);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the candidate neighbours of a fragment -- the fragments which share a bucket with
+    ///             the fragment or with its complement in any band, at most max_bucket from each bucket
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[out] candidates  The candidates (unordered, may include duplicates and the fragment itself)
+    // ------------------------------------------------------------------------------------------------------
+    void candidates(const size_t frag_idx, index_container& candidates) const;
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Mixes the bits of a value (splitmix64), to create independent hash functions
+    /// @param[in]  value   The value to hash
+    // ------------------------------------------------------------------------------------------------------
+    static inline hash_type mix(hash_type value)
+    {
+        value += 0x9e3779b97f4a7c15ULL;
+        value  = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value  = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the band hashes of a fragment, or of its complement
+    /// @param[in]  frag_idx    The index of the fragment
+    /// @param[in]  complement  If the alleles of the fragment should be complemented
+    /// @param[out] band_hashes The hash of each band
+    // ------------------------------------------------------------------------------------------------------
+    void sketch(const size_t frag_idx, const bool complement, hash_type* band_hashes) const;
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+inline FragmentSketches::FragmentSketches(const data_type& data, const hash_type seed)
+: _data(&data), _seed(seed), _sketches(bands * data.reads), _complements(bands * data.reads),
+  _buckets(bands)
+{
+    tbb::parallel_for(size_t(0), _data->reads, [&](const size_t frag_idx)
+    {
+        sketch(frag_idx, false, &_sketches[bands * frag_idx]   );
+        sketch(frag_idx, true , &_complements[bands * frag_idx]);
+    });
+
+    // Each band has its own buckets, so the bands can be filled in parallel
+    tbb::parallel_for(size_t(0), bands, [&](const size_t band)
+    {
+        for (size_t frag_idx = 0; frag_idx < _data->reads; ++frag_idx)
+            _buckets[band][_sketches[bands * frag_idx + band]].push_back(frag_idx);
+    });
+}
+
+inline void FragmentSketches::candidates(const size_t frag_idx, index_container& candidates) const
+{
+    for (size_t band = 0; band < bands; ++band) {
+        for (const auto* band_hashes : { &_sketches, &_complements }) {
+            const auto bucket = _buckets[band].find((*band_hashes)[bands * frag_idx + band]);
+            if (bucket == _buckets[band].end()) continue;
+
+            // The fragments of a bucket are in order, so take those around where the fragment would be
+            const auto& members = bucket->second;
+            if (members.size() <= max_bucket) {
+                candidates.insert(candidates.end(), members.begin(), members.end());
+                continue;
+            }
+            const auto   position = std::lower_bound(members.begin(), members.end(), frag_idx);
+            const size_t first    = (position - members.begin()) + members.size() - max_bucket / 2;
+            for (size_t i = 0; i < max_bucket; ++i)
+                candidates.push_back(members[(first + i) % members.size()]);
+        }
+    }
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+inline void FragmentSketches::sketch(const size_t frag_idx   , const bool complement,
+                                     hash_type*   band_hashes) const
+{
+    hash_type   min_hashes[hashes];
+    const auto& read_info = _data->read_info[frag_idx];
+    std::fill(min_hashes, min_hashes + hashes, std::numeric_limits<hash_type>::max());
+
+    for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+        const uint8_t value = _data->data[read_info.offset() + snp_idx - read_info.start_index()];
+        if (value > 1) continue;
+
+        const hash_type element = mix(2 * snp_idx + (complement ? !value : value));
+        for (size_t i = 0; i < hashes; ++i)
+            min_hashes[i] = std::min(min_hashes[i], mix(element ^ mix(_seed + i)));
+    }
+
+    for (size_t band = 0; band < bands; ++band) {
+        hash_type band_hash = band;
+        for (size_t row = 0; row < rows; ++row) band_hash = mix(band_hash ^ min_hashes[band * rows + row]);
+        band_hashes[band] = band_hash;
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SKETCH_HPP
@@ -0,0 +1,146 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   sparse_reads.hpp
+/// @brief  Header file for the sparse reads container, which stores the values of reads which are mostly
+///         gaps as sorted (column, allele) entries, so that scans over those reads skip the gaps
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SPARSE_READS_HPP
+#define PARAHAPLO_SPARSE_READS_HPP
+
+#include <tbb/tbb.h>
+#include <stdint.h>
+#include <vector>
+
+#ifndef SPARSE_MAX_FILL
+    #define SPARSE_MAX_FILL     0.0625  // Reads with at most this fraction of values (0 | 1) are sparse
+#endif
+#ifndef SPARSE_MIN_LENGTH
+    #define SPARSE_MIN_LENGTH   32      // Reads shorter than this are always scanned densely
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      SparseReads
+/// @brief      The values of the sparse reads of a matrix of reads -- the reads whose fraction of values
+///             (elements which are 0 or 1, rather than gaps) is at most SPARSE_MAX_FILL. Each entry is a
+///             column and an allele packed into 32 bits, and the entries of a read are sorted by column and
+///             stored contiguously (offsets as for a CSR matrix). The dense reads have no entries, and are
+///             scanned over their span as before -- for_each_value chooses per read. At the default fill an
+///             entry per value takes at most the 2 bits per element of the span of the read, so the entries
+///             are never larger than the dense data of the reads they index.
+// ----------------------------------------------------------------------------------------------------------
+class SparseReads {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using entry_type        = uint32_t;
+    using entry_container   = std::vector<entry_type>;
+    using offset_container  = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    offset_container    _offsets;           //!< The offset of the entries of each read (and one past the end)
+    entry_container     _entries;           //!< The (column << 1 | allele) entries of the sparse reads
+    std::vector<bool>   _sparse;            //!< If each read is sparse
+    size_t              _sparse_reads;      //!< The number of sparse reads
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- creates an empty container (all reads dense)
+    // ------------------------------------------------------------------------------------------------------
+    SparseReads() : _sparse_reads(0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the sparse reads of a matrix, and stores their entries
+    /// @param[in]  reads       The number of reads
+    /// @param[in]  info        A function which gets the ReadInfo (start and end columns) of a read
+    /// @param[in]  value       A function which gets the value of a read at a column in its span
+    /// @tparam     InfoFunction    The type of the read info function
+    /// @tparam     ValueFunction   The type of the value function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename InfoFunction, typename ValueFunction>
+    void build(const size_t reads, InfoFunction info, ValueFunction value);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if a read is sparse -- false for a read which isn't in the container
+    /// @param[in]  read_idx    The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_sparse(const size_t read_idx) const
+    {
+        return read_idx < _sparse.size() && _sparse[read_idx];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of sparse reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t sparse_reads() const { return _sparse_reads; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of entries (the values of the sparse reads)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t entries() const { return _entries.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the column and the allele of each value (0 | 1) of a read, in
+    ///             column order -- from the entries of a sparse read, or by scanning the span of a dense one
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  start_idx   The first column of the span of the read
+    /// @param[in]  end_idx     The last column of the span of the read
+    /// @param[in]  value       A function which gets the value of the read at a column (for a dense read)
+    /// @param[in]  function    The function to call with the column and the allele of each value
+    // ------------------------------------------------------------------------------------------------------
+    template <typename ValueFunction, typename Function>
+    inline void for_each_value(const size_t  read_idx, const size_t start_idx, const size_t end_idx,
+                               ValueFunction value   , Function     function ) const
+    {
+        if (is_sparse(read_idx)) {
+            for (size_t i = _offsets[read_idx]; i < _offsets[read_idx + 1]; ++i)
+                function(static_cast<size_t>(_entries[i] >> 1), static_cast<uint8_t>(_entries[i] & 1));
+            return;
+        }
+        for (size_t col_idx = start_idx; col_idx <= end_idx; ++col_idx) {
+            const uint8_t elem_value = value(col_idx);
+            if (elem_value <= 1) function(col_idx, elem_value);
+        }
+    }
+};
+
+// -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
+
+// ------------------------------------------------- PUBLIC -------------------------------------------------
+
+template <typename InfoFunction, typename ValueFunction>
+void SparseReads::build(const size_t reads, InfoFunction info, ValueFunction value)
+{
+    // Count the values of each read in parallel, then lay out the entries of the sparse ones
+    offset_container values(reads, 0);
+    tbb::parallel_for(size_t(0), reads, [&](const size_t read_idx)
+    {
+        const auto& read_info = info(read_idx);
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx)
+            if (value(read_idx, col_idx) <= 1) ++values[read_idx];
+    });
+
+    _sparse.assign(reads, false);
+    _offsets.assign(reads + 1, 0);
+    _sparse_reads = 0;
+    for (size_t read_idx = 0; read_idx < reads; ++read_idx) {
+        const size_t length = info(read_idx).length();
+        _sparse[read_idx]   = length >= SPARSE_MIN_LENGTH && values[read_idx] <= SPARSE_MAX_FILL * length;
+        _offsets[read_idx + 1] = _offsets[read_idx] + (_sparse[read_idx] ? values[read_idx] : 0);
+        _sparse_reads += _sparse[read_idx];
+    }
+
+    _entries.resize(_offsets[reads]);
+    tbb::parallel_for(size_t(0), reads, [&](const size_t read_idx)
+    {
+        if (!_sparse[read_idx]) return;
+        const auto& read_info = info(read_idx);
+        size_t      entry     = _offsets[read_idx];
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            const uint8_t elem_value = value(read_idx, col_idx);
+            if (elem_value <= 1) _entries[entry++] = static_cast<entry_type>(col_idx << 1 | elem_value);
+        }
+    });
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SPARSE_READS_HPP
@@ -11,6 +11,8 @@
 #include "subblock.hpp"
 #include "snp_info_gpu.h"
 
+#include <algorithm>
+#include <numeric>
 #include <sstream>
 
 namespace haplo {
@@ -27,16 +29,19 @@ public:
     using concurrent_umap       = typename BaseBlock::concurrent_umap;
     using read_info_container   = typename BaseBlock::read_info_container;
     using snp_info_container    = typename BaseBlock::snp_info_container;
+    using index_container       = std::vector<size_t>;
     // ------------------------------------------------------------------------------------------------------
     static constexpr size_t     THREADS_X   = ThreadsX;
     static constexpr size_t     THREADS_Y   = ThreadsY;
 private:
     size_t              _num_nih;           //!< The number of NIH columns
     size_t              _index;             //!< The index of the unsplittable block within the base block
+    size_t              _component;         //!< The component of the subblock which this has (or all)
     size_t              _cols;              //!< The number of columns in the sub block
     size_t              _rows;              //!< The number of rows in the sub block 
     size_t              _elements;          //!< The number of elements in the sub block
     size_t              _base_start_row;    //!< The start row of the subblock in the base block
+    index_container     _dropped;           //!< The reads of the base block dropped by the coverage cap
     
     binary_vector       _data;              //!< The data for the block
     binary_vector       _haplo_one;         //!< The first haplotype
@@ -58,6 +63,18 @@ private:
     template <typename SubBlockType, byte DeviceType>
     friend class Graph;
 
+    // The exact solver is a friend so that it can set the haplotypes
+    template <typename SubBlockType>
+    friend class ExactSolver;
+
+    // The multilevel solver is a friend so that it can use the duplicate rows and set the haplotypes
+    template <typename SubBlockType>
+    friend class MultilevelSolver;
+
+    // The dispatcher is a friend so that it can set the haplotypes of trivial sub-blocks
+    template <typename SubBlockType>
+    friend class Dispatcher;
+
 public:
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Constructor for when the size (number of elements) is not given (this is the preferred way
@@ -68,8 +85,10 @@ public:
     /// @param[in]  block   The block from which this block derives
     /// @param[in]  index   The index of the unsplittable block within blokc (block has a specific number of 
     ///             unsplittable blocks which can be made from it)
+    /// @param[in]  component   The component of the subblock to take (see Block::column_components) -- only
+    ///             its columns and the reads which have values in them -- or component::all
     // ------------------------------------------------------------------------------------------------------
-    explicit SubBlock(const BaseBlock& block, const size_t index);
+    explicit SubBlock(const BaseBlock& block, const size_t index, const size_t component = component::all);
    
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the value of the element at position row_idx, col_idx
@@ -82,6 +101,11 @@ public:
     /// @brief      Gets the index of the sub block
     // ------------------------------------------------------------------------------------------------------
     inline size_t index() const { return _index; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the component of the sub block which this has (component::all for the whole block)
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t component() const { return _component; }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the number of reads that make up the sub block
@@ -127,6 +151,17 @@ public:
     // @brief       Gets the number of NIH columns
     // ------------------------------------------------------------------------------------------------------
     inline size_t nih_columns() const { return _num_nih; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of rows which are duplicates of another row
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t duplicate_rows() const { return _duplicate_rows.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the reads of the base block which were dropped to cap the coverage of the columns
+    ///             (see Block::set_max_coverage) -- they aren't phased, but still count in the block MEC
+    // ------------------------------------------------------------------------------------------------------
+    inline const index_container& dropped_reads() const { return _dropped; }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets a reference to the read information
@@ -205,11 +240,42 @@ private:
     /// @brief      Adds elements to the data vector and updates the offset
     /// @param[in]  row_idx         The index of the row that the elements are being added for
     /// @param[in]  read_length     The number of elements to add from the read
-    /// @param[in]  mono_weights    The weights for how many monotone columes are before the start index
+    /// @param[in]  mono_weights    The weights for how many removed columns are before the start index
+    /// @param[in]  removed         If each column of the subblock is removed (monotone, or in another
+    ///                             component)
     /// @param[in]  offset          The offset in memory for where to start adding the elements
     // ------------------------------------------------------------------------------------------------------
-    size_t add_elements(const size_t               row_idx     , const size_t read_length, 
-                        const std::vector<size_t>& mono_weights, size_t       offset     );    
+    size_t add_elements(const size_t               row_idx     , const size_t             read_length,
+                        const std::vector<size_t>& mono_weights, const std::vector<bool>& removed    ,
+                        size_t                     offset      );
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if a read of the base block has a value (0 or 1) in a column which isn't removed
+    /// @param[in]  row_idx     The index of the read in the base block
+    /// @param[in]  removed     If each column of the subblock is removed
+    // ------------------------------------------------------------------------------------------------------
+    bool in_component(const size_t row_idx, const std::vector<bool>& removed) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the column (relative to the start of the subblock) of each value
+    ///             (0 or 1) of a read of the base block which is in a column which isn't removed
+    /// @param[in]  row_idx     The index of the read in the base block
+    /// @param[in]  removed     If each column of the subblock is removed
+    /// @param[in]  function    The function to call with each column
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    void for_each_kept_value(const size_t row_idx, const std::vector<bool>& removed, Function function) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Selects the reads of the subblock so that the columns have about the max coverage of the
+    ///             block at most. The reads are taken greedily, the most values and then the longest first,
+    ///             while all of their columns are below the cap -- then a dropped read is taken back if it
+    ///             has the only value of a column, so that every column is kept, which can take its other
+    ///             columns over the cap (so the cap is soft)
+    /// @param[in]  removed     If each column of the subblock is removed
+    /// @param[out] keep        If each read of the base block is kept
+    // ------------------------------------------------------------------------------------------------------
+    void select_reads(const std::vector<bool>& removed, std::vector<bool>& keep);
 };
 
 // -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
@@ -217,11 +283,13 @@ private:
 // ----------------------------------------------- PUBLIC ---------------------------------------------------
 
 template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
-SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::SubBlock(const BaseBlock& block, 
-                                                                const size_t     index) 
+SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::SubBlock(const BaseBlock& block    ,
+                                                                const size_t     index    ,
+                                                                const size_t     component)
 : BaseBlock(block)                                                      , 
   _num_nih(0)                                                           ,
   _index(index)                                                         , 
+  _component(component)                                                 , 
   _cols(block.subblock(index + 1) - block.subblock(index) + 1)          ,
   _rows(0)                                                              ,                        
   _elements(0)                                                          ,
@@ -278,12 +346,27 @@ void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::fill()
 {
     size_t offset = 0; size_t monos_found = 0; bool first_row_set = false;
     std::vector<size_t> mono_weights(base_end_index() - base_start_index() + 1);
+    std::vector<bool>   removed(base_end_index() - base_start_index() + 1, false);
+
+    // With a component, the columns of the other components are removed as the monotone columns are
+    const auto&  components = base_block()->column_components(_index);
+    const bool   one_part   = _component == component::all || components.empty();
+    size_t       snp_idx    = 0;
     
     for (size_t col_idx = base_start_index(); col_idx <= base_end_index(); ++col_idx) {
-        if (base_block()->is_monotone(col_idx)) ++monos_found;
-        mono_weights[col_idx - base_start_index()] = monos_found;
+        const size_t rel_idx = col_idx - base_start_index();
+        if (base_block()->is_monotone(col_idx))
+            removed[rel_idx] = true;
+        else
+            removed[rel_idx] = !one_part && components[snp_idx++] != _component;
+        if (removed[rel_idx]) ++monos_found;
+        mono_weights[rel_idx] = monos_found;
     }
-    _cols -= monos_found;       // Subtract the number of montone columns from the total columns
+    _cols -= monos_found;       // Subtract the number of removed columns from the total columns
+
+    // With a coverage cap, only the most informative reads are kept
+    std::vector<bool> keep;
+    if (base_block()->max_coverage() > 0) select_reads(removed, keep);
     
     // Go over each of the data rows and check for singularity
     for (size_t row_idx = 0; row_idx < base_block()->reads(); ++row_idx) {
@@ -294,10 +377,21 @@ void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::fill()
             // Determine the parameters of the read
             auto read_length = base_block()->read_info(row_idx).length();
 
+            // A read is in one component -- the component of the columns it has values in
+            if (!one_part && !in_component(row_idx, removed)) continue;
+            if (!keep.empty() && !keep[row_idx]) continue;
+
             // If the read is not singular
             if (read_length > 1) {
                 _read_info.push_back(ReadInfo(_rows, 0, 0, offset));
-                offset = add_elements(row_idx, read_length, mono_weights, offset);
+                const size_t start_offset = offset;
+                offset = add_elements(row_idx, read_length, mono_weights, removed, offset);
+                if (offset == start_offset) {
+                    // Only monotone columns, so nothing to phase
+                    _read_info.pop_back();
+                    if (!first_row_set) ++_base_start_row;
+                    continue;
+                }
                 _elements += _read_info[_rows].length();
                 ++_rows;
                 
@@ -317,36 +411,31 @@ size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::add_elements(
                                                             const size_t               base_row_idx,
                                                             const size_t               read_length ,
                                                             const std::vector<size_t>& mono_weights,
+                                                            const std::vector<bool>&   removed     ,
                                                             size_t                     offset      )
 {
     // Make sure there is enough space
     _data.resize(_data.size() + read_length);                       
  
-    // The start and end index of the column
+    // The start of the read relative to the start of the sub-block
     size_t read_start     = base_block()->read_info(base_row_idx).start_index() - base_start_index();
-    size_t start_col      = read_start - mono_weights[read_start];
-    size_t end_col        = start_col + read_length;
-    
-    // For the case where the start element of a read is monotone, re add the mono weight
-    if (base_block()->is_monotone(read_start + base_start_index())) {
-        start_col = read_start; end_col = start_col + read_length;
-    }
     
     bool   start_set    = false;        // If the start element has been found
     size_t num_elements = 0;            // Number of elements in the read
-    size_t mono_counter = 0;            // Number of monotones as the start of the read
     
-    for (size_t col_idx = start_col; col_idx < end_col; ++col_idx) {
-        auto   base_col_idx  = col_idx + base_start_index() + mono_weights[read_start];
-        auto   base_elem_val = base_block()->operator()(base_row_idx, base_col_idx);
-        bool   is_mono_col   = base_block()->is_monotone(base_col_idx);
+    for (size_t rel_idx = read_start; rel_idx < read_start + read_length; ++rel_idx) {
+        auto   base_col_idx  = rel_idx + base_start_index();
+        auto   base_elem_val = base_block()->normalised(base_row_idx, base_col_idx);
+        bool   is_mono_col   = removed[rel_idx];
+        
+        // Removed columns are skipped, so the column is offset by the removed columns up to it
+        auto   col_idx       = rel_idx - mono_weights[rel_idx];
 
         // If not a monotone column, and start is not found, set start
-        // otherwise count the number of initial monotone columns
         if (!start_set && !is_mono_col) { 
-            _read_info[_rows].set_start_index(col_idx - mono_counter);
+            _read_info[_rows].set_start_index(col_idx);
             start_set = true;
-        } else if (!start_set && is_mono_col) ++mono_counter;
+        }
         
         // Check to see if the column is NIH
         if (!is_mono_col && !base_block()->is_intrin_hetro(base_col_idx)) 
@@ -366,12 +455,104 @@ size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::add_elements(
             ++num_elements;
         }
     }
-    // Set the end index
-    _read_info[_rows].set_end_index(_read_info[_rows].start_index() + num_elements - 1);
+    // Set the end index (a read with only monotone columns has no elements, and is removed by fill)
+    if (num_elements > 0) _read_info[_rows].set_end_index(_read_info[_rows].start_index() + num_elements - 1);
     
     return offset;
 }
 
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
+bool SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::in_component(
+                                                                const size_t             row_idx,
+                                                                const std::vector<bool>& removed) const
+{
+    bool found = false;
+    for_each_kept_value(row_idx, removed, [&](const size_t) { found = true; });
+    return found;
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> template <typename Function>
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::for_each_kept_value(
+                                                                const size_t             row_idx ,
+                                                                const std::vector<bool>& removed ,
+                                                                Function                 function) const
+{
+    const auto& read_info = base_block()->read_info(row_idx);
+    base_block()->sparse_reads().for_each_value(row_idx, read_info.start_index(), read_info.end_index(),
+        [&](const size_t col_idx) { return (*base_block())(row_idx, col_idx); },
+        [&](const size_t col_idx, const uint8_t)
+        {
+            const size_t rel_idx = col_idx - base_start_index();
+            if (!removed[rel_idx]) function(rel_idx);
+        }
+    );
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::select_reads(const std::vector<bool>& removed,
+                                                                         std::vector<bool>&       keep   )
+{
+    // The reads which fill would take, and their values in the kept columns -- reads with none are left
+    // for fill to skip
+    const size_t    max_coverage = base_block()->max_coverage();
+    index_container rows, values;
+    keep.assign(base_block()->reads(), true);
+    for (size_t row_idx = 0; row_idx < base_block()->reads(); ++row_idx) {
+        const auto& read_info = base_block()->read_info(row_idx);
+        if (read_info.start_index() < base_start_index() || read_info.end_index() > base_end_index() ||
+            read_info.length() <= 1) continue;
+
+        size_t count = 0;
+        for_each_kept_value(row_idx, removed, [&](const size_t) { ++count; });
+        if (count == 0) continue;
+        rows.push_back(row_idx);
+        values.push_back(count);
+    }
+
+    // The most informative reads first
+    index_container order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
+    {
+        const size_t length_a = base_block()->read_info(rows[a]).length();
+        const size_t length_b = base_block()->read_info(rows[b]).length();
+        if (values[a] != values[b]) return values[a] > values[b];
+        return length_a != length_b ? length_a > length_b : rows[a] < rows[b];
+    });
+
+    index_container   coverage(removed.size(), 0);
+    std::vector<bool> taken(rows.size(), false);
+    const auto take = [&](const size_t i)
+    {
+        taken[i] = true;
+        for_each_kept_value(rows[i], removed, [&](const size_t rel_idx) { ++coverage[rel_idx]; });
+    };
+    for (const auto i : order) {
+        bool fits = true;
+        for_each_kept_value(rows[i], removed, [&](const size_t rel_idx)
+        {
+            fits = fits && coverage[rel_idx] < max_coverage;
+        });
+        if (fits) take(i);
+    }
+    for (const auto i : order) {
+        if (taken[i]) continue;
+        bool needed = false;
+        for_each_kept_value(rows[i], removed, [&](const size_t rel_idx)
+        {
+            needed = needed || coverage[rel_idx] == 0;
+        });
+        if (needed) take(i);
+    }
+
+    _dropped.clear();
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (taken[i]) continue;
+        keep[rows[i]] = false;
+        _dropped.push_back(rows[i]);
+    }
+}
+
 template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
 void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::set_col_params(const size_t   col_idx,
                                                                            const size_t   row_idx,
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   union_find.hpp
+/// @brief  Header file for the union find (disjoint set) container, which groups elements into the
+///         connected components of the links between them
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_UNION_FIND_HPP
+#define PARAHAPLO_UNION_FIND_HPP
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      UnionFind
+/// @brief      Disjoint sets of the elements 0 to elements - 1, joined by size with path halving, so that a
+///             sequence of joins and finds is almost linear in its length
+// ----------------------------------------------------------------------------------------------------------
+class UnionFind {
+public:
+    // ---------------------------------------------- ALIAS'S -----------------------------------------------
+    using index_container   = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+private:
+    index_container     _parent;            //!< The parent of each element (itself for the root of a set)
+    index_container     _size;              //!< The number of elements in the set of each root
+    size_t              _sets;              //!< The number of sets
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- each element is in a set of its own
+    /// @param[in]  elements    The number of elements
+    // ------------------------------------------------------------------------------------------------------
+    explicit UnionFind(const size_t elements)
+    : _parent(elements), _size(elements, 1), _sets(elements)
+    {
+        for (size_t idx = 0; idx < elements; ++idx) _parent[idx] = idx;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of sets
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t sets() const { return _sets; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the root of the set of an element
+    /// @param[in]  idx     The index of the element
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t find(size_t idx)
+    {
+        while (_parent[idx] != idx) {
+            _parent[idx] = _parent[_parent[idx]];
+            idx          = _parent[idx];
+        }
+        return idx;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Joins the sets of two elements
+    /// @param[in]  first   The index of the first element
+    /// @param[in]  second  The index of the second element
+    // ------------------------------------------------------------------------------------------------------
+    inline void join(const size_t first, const size_t second)
+    {
+        size_t root_one = find(first), root_two = find(second);
+        if (root_one == root_two) return;
+        if (_size[root_one] < _size[root_two]) std::swap(root_one, root_two);
+        _parent[root_two]  = root_one;
+        _size[root_one]   += _size[root_two];
+        --_sets;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Labels the set of each element, with the sets numbered in the order of their first
+    ///             elements
+    /// @param[out] labels  The label of each element
+    // ------------------------------------------------------------------------------------------------------
+    void labels(index_container& labels)
+    {
+        index_container label_of_root(_parent.size(), size_t(none));
+        size_t          next = 0;
+        labels.resize(_parent.size());
+        for (size_t idx = 0; idx < _parent.size(); ++idx) {
+            const size_t root = find(idx);
+            if (label_of_root[root] == none) label_of_root[root] = next++;
+            labels[idx] = label_of_root[root];
+        }
+    }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_UNION_FIND_HPP
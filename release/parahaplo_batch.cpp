@@ -0,0 +1,38 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   parahaplo_batch.cpp
+/// @brief  Main file for the parahaplo batch runner, which phases many input files in one process
+// ----------------------------------------------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/batch.hpp"
+
+#ifndef MAX_ELEMENTS
+    #define MAX_ELEMENTS    4000000     // The most elements (read values) in an input
+#endif
+
+using block_type    = haplo::Block<MAX_ELEMENTS, 4, 4>;
+using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+using runner_type   = haplo::BatchRunner<block_type, subblock_type>;
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage : " << argv[0] << " <manifest file | glob pattern> <output directory> "
+                  << "[jobs] [memory cap per job (MB)]\n";
+        return 1;
+    }
+
+    // A pattern has wildcards, otherwise the argument is a manifest
+    const std::string inputs = argv[1];
+    const auto files = inputs.find_first_of("*?[") != std::string::npos
+                     ? runner_type::from_glob(inputs) : runner_type::from_manifest(inputs);
+    const size_t jobs       = argc > 3 ? std::stoul(argv[3]) : BATCH_JOBS;
+    const size_t memory_cap = argc > 4 ? std::stoul(argv[4]) << 20 : 0;
+
+    runner_type runner(haplo::CostModel(), jobs, memory_cap);
+    runner.run(files, argv[2]);
+    runner.write_summary(std::cout);
+}
@@ -0,0 +1,79 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   parahaplo_cpu.cpp
+/// @brief  Main file for the parahaplo cpu phasing driver
+// ----------------------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/driver.hpp"
+
+#ifndef MAX_ELEMENTS
+    #define MAX_ELEMENTS    4000000     // The most elements (read values) in the input
+#endif
+
+using namespace std::chrono;
+
+using block_type    = haplo::Block<MAX_ELEMENTS, 4, 4>;
+using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+using driver_type   = haplo::Driver<block_type, subblock_type>;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage : " << argv[0] << " <input file> [solve threads] [output file] [cache file]"
+                  << " [checkpoint file]\n       (- for an optional file which isn't used)\n";
+        return 1;
+    }
+    const size_t threads = argc > 2 ? std::stoul(argv[2]) : 0;
+    const auto   given   = [&](const int i) { return argc > i && std::string(argv[i]) != "-"; };
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    // The block is large (it holds all of the elements), so it goes on the heap
+    std::unique_ptr<block_type> block(new block_type(argv[1]));
+    driver_type driver(haplo::CostModel(), threads);
+
+    // Sub-blocks solved in an earlier run with the same cache file are not solved again
+    std::unique_ptr<haplo::ResultCache> cache;
+    if (given(4)) {
+        cache.reset(new haplo::ResultCache(argv[4]));
+        driver.set_cache(cache.get());
+    }
+
+    // A run which was stopped resumes from its checkpoint, and only solves the sub-blocks it hadn't saved
+    std::unique_ptr<haplo::Checkpoint> checkpoint;
+    if (given(5)) {
+        checkpoint.reset(new haplo::Checkpoint(argv[5]));
+        driver.set_checkpoint(checkpoint.get());
+    }
+
+    // With an output file the regions are streamed as they are solved, otherwise they are merged and printed
+    if (given(3)) {
+        std::ofstream                   output(argv[3]);
+        haplo::RegionWriter<block_type>   writer(*block, output);
+        driver.run(*block, writer);
+    } else {
+        driver.run(*block);
+    }
+
+    duration<double> run_time = duration_cast<duration<double>>(high_resolution_clock::now() - start);
+
+    if (!given(3)) {
+        block->print_haplotypes();
+        block->determine_mec_score();
+    }
+    std::cout << "SUB-BLOCKS : " << driver.dispatcher().log().size() << " solved, " << driver.resumed()
+              << " resumed, " << block->num_subblocks() - 1 << " total\n"
+              << "TIME       : " << run_time.count() << "s\n"
+              << "SCHEDULE   : " << driver.report().tasks << " tasks, " << driver.report().batched
+              << " batched, " << driver.report().efficiency() * 100.0 << "% of the ideal makespan\n";
+    if (cache) {
+        std::cout << "CACHE      : " << cache->hits() << " hits, " << cache->misses() << " misses, "
+                  << cache->size() << " solutions\n";
+    }
+}
@@ -0,0 +1,145 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   parahaplo_shard.cpp
+/// @brief  Main file for sharded phasing -- cuts an input into shards, phases a shard (a worker, which can
+///         run on any machine which can read the shard), and merges the haplotypes of the shards
+// ----------------------------------------------------------------------------------------------------------
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/driver.hpp"
+#include "../haplo/shard.hpp"
+
+#ifndef MAX_ELEMENTS
+    #define MAX_ELEMENTS    4000000     // The most elements (read values) in the input
+#endif
+
+using block_type    = haplo::Block<MAX_ELEMENTS, 4, 4>;
+using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+using driver_type   = haplo::Driver<block_type, subblock_type>;
+
+// Cuts the input into shards in the directory
+int split(const std::string& input, const size_t shards, const std::string& directory)
+{
+    std::unique_ptr<block_type> block(new block_type(input.c_str()));
+    haplo::Sharder sharder(directory);
+    try {
+        if (sharder.split(*block, input, shards) == 0) {
+            std::cerr << "No shards : " << input << " has no columns\n";
+            return 1;
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what();
+        return 1;
+    }
+    for (const auto& shard : sharder.shards()) {
+        std::cout << "SHARD " << shard.index << " : columns " << shard.start_col << " - " << shard.end_col
+                  << ", " << shard.reads << " reads -> " << shard.input << "\n";
+    }
+    return 0;
+}
+
+// Phases a shard, and writes its haplotypes to its result file
+int phase(const std::string& input, const std::string& result, const size_t threads)
+{
+    std::unique_ptr<block_type> block(new block_type(input.c_str()));
+    driver_type driver(haplo::CostModel(), threads);
+    driver.run(*block);
+
+    // Written to a temporary file and renamed, so a result file is always complete
+    const std::string partial = result + ".partial";
+    {
+        std::ofstream output(partial);
+        block->write_haplotypes(output);
+        if (!output) return 1;
+    }
+    return std::rename(partial.c_str(), result.c_str()) == 0 ? 0 : 1;
+}
+
+// Merges the results of the shards in the directory, and writes the haplotypes
+int merge(const std::string& directory, const std::string& output, const std::string& input)
+{
+    haplo::Sharder         sharder(directory);
+    haplo::BinaryVector<2> haplo_one, haplo_two;
+    try {
+        sharder.merge(haplo_one, haplo_two);
+    } catch (const std::exception& error) {
+        std::cerr << error.what();
+        return 1;
+    }
+
+    std::ofstream output_file(output);
+    for (size_t i = 0; i < haplo_one.size(); ++i) output_file << static_cast<char>('0' + haplo_one.get(i));
+    output_file << "\n";
+    for (size_t i = 0; i < haplo_two.size(); ++i) output_file << static_cast<char>('0' + haplo_two.get(i));
+    output_file << "\n";
+    if (!output_file.flush()) {
+        std::cerr << "Could not write output file " << output << "\n";
+        return 1;
+    }
+
+    std::cout << "MERGED     : " << sharder.shards().size() << " shards, " << haplo_one.size()
+              << " columns\n";
+    if (!input.empty()) {
+        std::unique_ptr<block_type> block(new block_type(input.c_str()));
+        std::cout << "MEC SCORE  : " << block->mec_score(haplo_one, haplo_two) << "\n";
+    }
+    return 0;
+}
+
+// Splits the input, phases each shard in a worker process on this machine, and merges the shards
+int run(const std::string& input    , const size_t       shards,
+        const std::string& directory, const std::string& output)
+{
+    if (split(input, shards, directory) != 0) return 1;
+
+    // Each worker is a new process (this one has started tbb, so it isn't forked without an exec)
+    haplo::Sharder     sharder(directory);
+    if (sharder.shards().empty()) {
+        std::cerr << "No shards in manifest " << sharder.manifest() << "\n";
+        return 1;
+    }
+    std::vector<pid_t> workers;
+    for (const auto& shard : sharder.shards()) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            execl("/proc/self/exe", "parahaplo_shard", "phase", shard.input.c_str(), shard.result.c_str(),
+                  "1", static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        workers.push_back(pid);
+    }
+
+    int failed = 0;
+    for (const auto pid : workers) {
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ++failed;
+    }
+    if (failed > 0) {
+        std::cerr << failed << " of " << workers.size() << " workers failed\n";
+        return 1;
+    }
+    return merge(directory, output, input);
+}
+
+int main(int argc, char** argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "split" && argc > 4) return split(argv[2], std::stoul(argv[3]), argv[4]);
+    if (mode == "phase" && argc > 3) return phase(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 0);
+    if (mode == "merge" && argc > 3) return merge(argv[2], argv[3], argc > 4 ? argv[4] : "");
+    if (mode == "run"   && argc > 5) return run(argv[2], std::stoul(argv[3]), argv[4], argv[5]);
+
+    std::cerr << "Usage : " << argv[0] << " split <input file> <shards> <shard directory>\n"
+              << "        " << argv[0] << " phase <shard file> <result file> [solve threads]\n"
+              << "        " << argv[0] << " merge <shard directory> <output file> [input file (for MEC)]\n"
+              << "        " << argv[0] << " run   <input file> <shards> <shard directory> <output file>\n";
+    return 1;
+}
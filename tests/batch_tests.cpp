@@ -0,0 +1,146 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   batch_tests.cpp
+/// @brief  Test suite for parahaplo batch runner tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE BatchTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/batch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+
+static constexpr const char* input_four = "input_files/input_four.txt";
+static constexpr const char* input_six  = "input_files/input_six.txt";
+static constexpr const char* output_dir = "batch_test_output";
+
+using block_type    = haplo::Block<6000, 2, 2>;
+using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using driver_type   = haplo::Driver<block_type, subblock_type>;
+using runner_type   = haplo::BatchRunner<block_type, subblock_type>;
+
+BOOST_AUTO_TEST_SUITE( BatchSuite )
+
+BOOST_AUTO_TEST_CASE( batchMatchesPhasingEachFile )
+{
+    runner_type runner(haplo::CostModel(), 2);
+    const auto& results = runner.run({ input_four, input_six, "input_files/missing.txt" }, output_dir);
+
+    BOOST_REQUIRE( results.size() == 3 );
+    for (size_t i = 0; i < 2; ++i) {
+        block_type  block(results[i].input.c_str());
+        driver_type driver;
+        driver.run(block);
+
+        BOOST_CHECK( results[i].status    == haplo::job::solved );
+        BOOST_CHECK( results[i].mec_score == block.mec_score() );
+        BOOST_CHECK( results[i].snps      == block.haplo_one().size() );
+
+        // The output file has the two haplotypes
+        std::ifstream output(results[i].output);
+        std::string   haplo_one, haplo_two;
+        BOOST_REQUIRE( output >> haplo_one >> haplo_two );
+        for (size_t col_idx = 0; col_idx < block.haplo_one().size(); ++col_idx) {
+            BOOST_CHECK( haplo_one[col_idx] - '0' == block.haplo_one().get(col_idx) );
+            BOOST_CHECK( haplo_two[col_idx] - '0' == block.haplo_two().get(col_idx) );
+        }
+        std::remove(results[i].output.c_str());
+    }
+    BOOST_CHECK( results[2].status == haplo::job::failed );
+    BOOST_CHECK( !results[2].message.empty() );
+    std::remove((std::string(output_dir) + "/summary.tsv").c_str());
+}
+
+BOOST_AUTO_TEST_CASE( batchRespectsTheMemoryCap )
+{
+    // Too small for the block and a sub-block
+    runner_type skipped(haplo::CostModel(), 1, sizeof(block_type));
+    BOOST_CHECK( skipped.run({ input_six }, output_dir).front().status == haplo::job::skipped );
+
+    // Room for the block and only one sub-block in flight
+    std::ifstream input(input_six, std::ios::binary | std::ios::ate);
+    runner_type   capped(haplo::CostModel(), 1, 2 * runner_type::copy_bytes(input.tellg()));
+    const auto& result = capped.run({ input_six }, output_dir).front();
+    BOOST_CHECK( result.status    == haplo::job::solved );
+    BOOST_CHECK( result.in_flight == 1 );
+    std::remove(result.output.c_str());
+    std::remove((std::string(output_dir) + "/summary.tsv").c_str());
+    std::remove(output_dir);
+}
+
+BOOST_AUTO_TEST_CASE( aMalformedInputOnlyFailsItsOwnJob )
+{
+    // A copy of an input with CRLF line endings
+    const std::string malformed = std::string(output_dir) + "_crlf.txt";
+    {
+        std::ifstream input(input_four);
+        std::ofstream output(malformed);
+        std::string   line;
+        while (std::getline(input, line)) output << line << "\r\n";
+    }
+
+    runner_type runner(haplo::CostModel(), 2);
+    const auto& results = runner.run({ input_four, malformed, input_six }, output_dir);
+    BOOST_REQUIRE( results.size() == 3 );
+    BOOST_CHECK( results[0].status == haplo::job::solved );
+    BOOST_CHECK( results[1].status == haplo::job::failed );
+    BOOST_CHECK( !results[1].message.empty()             );
+    BOOST_CHECK( results[2].status == haplo::job::solved );
+
+    std::ifstream summary(std::string(output_dir) + "/summary.tsv");
+    BOOST_CHECK( summary.good() );
+    for (const auto& result : results) std::remove(result.output.c_str());
+    std::remove((std::string(output_dir) + "/summary.tsv").c_str());
+    std::remove(output_dir);
+    std::remove(malformed.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( jobsFailWhenTheirOutputCantBeWritten )
+{
+    // A directory in the way of the output file
+    const std::string blocked = std::string(output_dir) + "/input_files_input_four.txt.haplo";
+    mkdir(output_dir, 0755);
+    mkdir(blocked.c_str(), 0755);
+    runner_type runner(haplo::CostModel(), 1);
+    const auto& result = runner.run({ input_four }, output_dir).front();
+    BOOST_CHECK( result.status == haplo::job::failed );
+    BOOST_CHECK( !result.message.empty() );
+    std::remove(blocked.c_str());
+    std::remove((std::string(output_dir) + "/summary.tsv").c_str());
+    std::remove(output_dir);
+
+    // An output directory which can't be created
+    const auto& results = runner.run({ input_four, input_six }, std::string(input_four) + "/output");
+    BOOST_REQUIRE( results.size() == 2 );
+    for (const auto& failed : results) {
+        BOOST_CHECK( failed.status == haplo::job::failed );
+        BOOST_CHECK( failed.message.find("output directory") != std::string::npos );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canReadAManifestAndAGlob )
+{
+    const std::string manifest = std::string(output_dir) + ".manifest";
+    {
+        std::ofstream file(manifest);
+        file << input_four << "\n\n" << input_six << "  \n";
+    }
+    const auto inputs = runner_type::from_manifest(manifest);
+    BOOST_REQUIRE( inputs.size() == 2 );
+    BOOST_CHECK( inputs[0] == input_four );
+    BOOST_CHECK( inputs[1] == input_six  );
+    std::remove(manifest.c_str());
+
+    const auto matches = runner_type::from_glob("input_files/input_s*.txt");
+    BOOST_CHECK( std::find(matches.begin(), matches.end(), input_six) != matches.end() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
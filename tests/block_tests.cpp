@@ -11,11 +11,14 @@
 #include <chrono>
 
 #include "../haplo/subblock_cpu.hpp"
+#include "../haplo/graph_cpu.hpp"
 
 using namespace std::chrono;
 
 static constexpr const char* input_1      = "input_files/input_zero.txt";
 static constexpr const char* input_6      = "input_files/input_six.txt";
+static constexpr const char* input_8      = "input_files/input_eight.txt";
+static constexpr const char* input_10     = "input_files/input_ten.txt";
 static constexpr const char* input_7      = "tests_files/output_7.txt";
 static constexpr const char* input_test_1 = "tests_files/output_1.txt";     // 1543 elements
 
@@ -80,4 +83,163 @@ BOOST_AUTO_TEST_CASE( canDetermineSplittableColumns )
     BOOST_CHECK( block.subblock(3)     == 11 );
 }
 
+BOOST_AUTO_TEST_CASE( canSolveTrivialSubblocksDirectly )
+{
+    using block_type = haplo::Block<28, 4, 4>;
+    
+    block_type block(input_1);
+    
+    // All of the subblocks of the input are small, the last splittable column doesn't start one
+    BOOST_CHECK( block.is_trivial(0) == true  );
+    BOOST_CHECK( block.is_trivial(1) == true  );
+    BOOST_CHECK( block.is_trivial(2) == true  );
+    BOOST_CHECK( block.is_trivial(3) == false );
+    BOOST_CHECK( block.solve_trivial(3) == false );
+   
+    // Subblock 1 has the reads 01 and 10 over columns 3 and 4, so the haplotypes are those reads
+    BOOST_CHECK( block.solve_trivial(1) == true );
+    BOOST_CHECK( block.haplo_one().get(3) != block.haplo_one().get(4) );
+    BOOST_CHECK( block.haplo_one().get(3) != block.haplo_two().get(3) );
+    BOOST_CHECK( block.haplo_one().get(4) != block.haplo_two().get(4) );
+}
+
+BOOST_AUTO_TEST_CASE( canNormaliseColumnsWithoutChangingData )
+{
+    using block_type    = haplo::Block<6000, 2, 2>;
+    using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type raw_block(input_6), norm_block(input_6);
+    norm_block.set_normalise(true);
+
+    // The flipped columns are read flipped, but the data itself is unchanged
+    size_t flipped = 0;
+    for (size_t col_idx = 0; col_idx < raw_block.haplo_one().size(); ++col_idx) {
+        const auto& snp_info = raw_block.snp_info(col_idx);
+        const bool  flip     = snp_info.ones() > snp_info.zeros() && !snp_info.is_monotone();
+        BOOST_CHECK( raw_block.column_flip(col_idx)  == 0    );
+        BOOST_CHECK( norm_block.column_flip(col_idx) == flip );
+        flipped += flip;
+
+        const size_t row_idx = snp_info.start_index();
+        BOOST_CHECK( norm_block(row_idx, col_idx)            == raw_block(row_idx, col_idx)        );
+        BOOST_CHECK( norm_block.normalised(row_idx, col_idx) == (raw_block(row_idx, col_idx) ^ flip) );
+    }
+    BOOST_CHECK( flipped > 0 );
+
+    // Solving the normalised subblock gives the same haplotypes once merged
+    subblock_type raw_sub_block(raw_block, 1), norm_sub_block(norm_block, 1);
+    graph_type    raw_graph(raw_sub_block), norm_graph(norm_sub_block);
+    raw_graph.search(); norm_graph.search();
+    raw_block.merge_haplotype(raw_sub_block); norm_block.merge_haplotype(norm_sub_block);
+
+    BOOST_CHECK( raw_graph.mec_score() == norm_graph.mec_score() );
+    for (size_t col_idx = raw_block.subblock(1); col_idx <= raw_block.subblock(2); ++col_idx) {
+        BOOST_CHECK( raw_block.haplo_one().get(col_idx) == norm_block.haplo_one().get(col_idx) );
+        BOOST_CHECK( raw_block.haplo_two().get(col_idx) == norm_block.haplo_two().get(col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canMergeStagedHaplotypesInParallel )
+{
+    using block_type    = haplo::Block<6000, 2, 2>;
+    using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    for (const auto normalise : { false, true }) {
+        block_type ordered(input_6), staged(input_6);
+        ordered.set_normalise(normalise); staged.set_normalise(normalise);
+        const size_t subblocks = ordered.num_subblocks() - 1;
+
+        for (size_t i = 0; i < subblocks; ++i) {
+            if (ordered.solve_trivial(i)) continue;
+            subblock_type sub_block(ordered, i);
+            graph_type    graph(sub_block);
+            graph.search();
+            ordered.merge_haplotype(sub_block);
+        }
+
+        // Solve the subblocks in any order, and merge them all at once
+        tbb::parallel_for(size_t(0), subblocks, [&](const size_t i)
+        {
+            if (staged.stage_trivial(i)) return;
+            subblock_type sub_block(staged, i);
+            graph_type    graph(sub_block);
+            graph.search();
+            staged.stage_haplotype(sub_block);
+        });
+        staged.merge_haplotypes();
+
+        for (size_t col_idx = 0; col_idx < ordered.haplo_one().size(); ++col_idx) {
+            BOOST_CHECK( staged.haplo_one().get(col_idx) == ordered.haplo_one().get(col_idx) );
+            BOOST_CHECK( staged.haplo_two().get(col_idx) == ordered.haplo_two().get(col_idx) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canMergeTrivialSubblocksStartingAtNihColumns )
+{
+    using block_type = haplo::Block<100, 2, 2>;
+    block_type ordered(input_10), staged(input_10);
+    const size_t subblocks = ordered.num_subblocks() - 1;
+
+    // All the subblocks are trivial, and some start at an NIH column where both haplotypes are the same
+    size_t nih_starts = 0;
+    for (size_t i = 0; i < subblocks; ++i) {
+        BOOST_CHECK( ordered.is_trivial(i) );
+        if (i > 0 && !ordered.is_intrin_hetro(ordered.subblock(i))) ++nih_starts;
+    }
+    BOOST_CHECK( nih_starts > 0 );
+
+    for (size_t i = 0; i < subblocks; ++i) ordered.solve_trivial(i);
+    tbb::parallel_for(size_t(0), subblocks, [&](const size_t i) { staged.stage_trivial(i); });
+    staged.merge_haplotypes();
+
+    // Trivial solutions are never flipped, so both are the exact solution
+    for (size_t col_idx = 0; col_idx < ordered.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( staged.haplo_one().get(col_idx) == ordered.haplo_one().get(col_idx) );
+        BOOST_CHECK( staged.haplo_two().get(col_idx) == ordered.haplo_two().get(col_idx) );
+    }
+    BOOST_CHECK( ordered.mec_score() == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( canIndexSparseReads )
+{
+    using block_type = haplo::Block<500, 2, 2>;
+    block_type  block(input_8);
+    const auto& sparse = block.sparse_reads();
+
+    // Only the long paired reads with few values are sparse (the shortest has too many values for its span)
+    BOOST_CHECK( sparse.sparse_reads() == 3 );
+    BOOST_CHECK( sparse.entries()      == 9 );
+    BOOST_CHECK( !sparse.is_sparse(0)  );
+    BOOST_CHECK( sparse.is_sparse(30)  );
+    BOOST_CHECK( sparse.is_sparse(32)  );
+    BOOST_CHECK( !sparse.is_sparse(33) );
+
+    // The values of each read are the same from the entries as from the dense data
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) {
+        const auto&         read_info = block.read_info(row_idx);
+        std::vector<size_t> dense, found;
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx)
+            if (block(row_idx, col_idx) <= 1) dense.push_back(2 * col_idx + block(row_idx, col_idx));
+
+        sparse.for_each_value(row_idx, read_info.start_index(), read_info.end_index(),
+            [&](const size_t col_idx) { return block(row_idx, col_idx); },
+            [&](const size_t col_idx, const uint8_t value) { found.push_back(2 * col_idx + value); }
+        );
+        BOOST_CHECK( found == dense );
+    }
+
+    // The paired reads are counted in the MEC score -- all zeros has the ones of every read
+    haplo::BinaryVector<2> zeros(block.haplo_one().size());
+    size_t                 ones = 0;
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) {
+        const auto& read_info = block.read_info(row_idx);
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx)
+            ones += block(row_idx, col_idx) == 1;
+    }
+    BOOST_CHECK( block.mec_score(zeros, zeros) == ones );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   dispatcher_tests.cpp
+/// @brief  Test suite for parahaplo solver dispatcher tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE DispatcherTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/dispatcher.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+static constexpr const char* input_three = "input_files/input_three.txt";
+static constexpr const char* input_six   = "input_files/input_six.txt";
+static constexpr const char* cache_file  = "dispatcher_test_cache.bin";
+
+using block_type      = haplo::Block<6000, 2, 2>;
+using subblock_type   = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+// Creates a profile for a sub-block with the given shape
+haplo::SubBlockProfile make_profile(const size_t reads, const size_t snps, const size_t coverage,
+                                    const size_t nih_columns)
+{
+    haplo::SubBlockProfile profile;
+    profile.reads           = reads;
+    profile.snps            = snps;
+    profile.coverage        = coverage;
+    profile.nih_columns     = nih_columns;
+    profile.element_spans   = coverage * snps;
+    profile.duplicate_ratio = 0.0;
+    profile.exact_states    = snps * std::ldexp(1.0, static_cast<int>(coverage));
+    return profile;
+}
+
+BOOST_AUTO_TEST_SUITE( DispatcherSuite )
+
+BOOST_AUTO_TEST_CASE( canChooseSolverFromProfile )
+{
+    dispatcher_type dispatcher;
+    double          estimate_ns;
+
+    const auto choose = [&](const size_t reads, const size_t snps, const size_t coverage, const size_t nih)
+    {
+        return dispatcher.choose(make_profile(reads, snps, coverage, nih), estimate_ns);
+    };
+
+    BOOST_CHECK( choose(1    , 40  , 1  , 10 ) == haplo::solver::trivial     );
+    BOOST_CHECK( choose(30   , 1   , 30 , 1  ) == haplo::solver::trivial     );
+    BOOST_CHECK( choose(6    , 8   , 4  , 2  ) == haplo::solver::exact       );
+    BOOST_CHECK( choose(80   , 80  , 24 , 60 ) == haplo::solver::multi_start );
+    BOOST_CHECK( choose(80   , 80  , 24 , 4  ) == haplo::solver::graph       );
+    BOOST_CHECK( choose(5000 , 800 , 120, 400) == haplo::solver::graph       );
+    BOOST_CHECK( choose(20000, 4000, 30 , 400) == haplo::solver::multilevel  );
+}
+
+BOOST_AUTO_TEST_CASE( canProfileSubBlock )
+{
+    block_type    block(input_three);
+    subblock_type sub_block(block, 1);
+
+    const auto profile = dispatcher_type::profile(sub_block);
+
+    BOOST_CHECK( profile.reads       == sub_block.reads()       );
+    BOOST_CHECK( profile.snps        == 8                       );
+    BOOST_CHECK( profile.coverage    == 6                       );
+    BOOST_CHECK( profile.nih_columns == sub_block.nih_columns() );
+}
+
+BOOST_AUTO_TEST_CASE( canDispatchAndLogSubBlocks )
+{
+    block_type         block_three(input_three), block_six(input_six);
+    subblock_type      sub_block_three(block_three, 1), sub_block_six(block_six, 1);
+    std::ostringstream log_stream;
+    dispatcher_type    dispatcher(haplo::CostModel(), &log_stream);
+
+    dispatcher.solve(sub_block_three);
+    dispatcher.solve(sub_block_six);
+
+    BOOST_CHECK( dispatcher.log().size() == 2                               );
+    BOOST_CHECK( dispatcher.log()[0].choice    == haplo::solver::exact      );
+    BOOST_CHECK( dispatcher.log()[0].mec_score == 2                         );
+    BOOST_CHECK( dispatcher.log()[1].choice    == haplo::solver::graph      );
+    BOOST_CHECK( log_stream.str().find("-> exact") != std::string::npos     );
+}
+
+BOOST_AUTO_TEST_CASE( solvedSubBlocksAreFoundInTheCache )
+{
+    block_type      block_three(input_three), block_six(input_six);
+    subblock_type   solved_three(block_three, 1), solved_six(block_six, 1);
+    dispatcher_type dispatcher;
+    std::remove(cache_file);
+    {
+        haplo::ResultCache cache(cache_file);
+        dispatcher.set_cache(&cache);
+        dispatcher.solve(solved_three);
+        dispatcher.solve(solved_six);
+        BOOST_CHECK( cache.misses() == 2 && cache.size() == 2 );
+    }
+
+    // A new run (a new cache over the same file) takes both solutions from the file
+    haplo::ResultCache cache(cache_file);
+    subblock_type      cached_three(block_three, 1), cached_six(block_six, 1);
+    dispatcher_type    rerun;
+    rerun.set_cache(&cache);
+    rerun.solve(cached_three);
+    rerun.solve(cached_six);
+
+    BOOST_CHECK( cache.hits() == 2 && cache.misses() == 0 );
+    for (size_t i = 0; i < 2; ++i) {
+        BOOST_CHECK( rerun.log()[i].cached                                   );
+        BOOST_CHECK( rerun.log()[i].mec_score == dispatcher.log()[i].mec_score );
+    }
+    for (size_t col_idx = 0; col_idx < solved_six.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( cached_six.haplo_one().get(col_idx) == solved_six.haplo_one().get(col_idx) );
+        BOOST_CHECK( cached_six.haplo_two().get(col_idx) == solved_six.haplo_two().get(col_idx) );
+    }
+
+    // Different settings are a different key
+    haplo::CostModel model;
+    model.max_neighbours = 2;
+    dispatcher_type  other(model);
+    other.set_cache(&cache);
+    other.solve(cached_six);
+    BOOST_CHECK( cache.misses() == 1 );
+    std::remove(cache_file);
+}
+
+BOOST_AUTO_TEST_CASE( aFileWhichIsNotACacheIsLeftAlone )
+{
+    {
+        std::ofstream other(cache_file);
+        other << "0 1 01\n";
+    }
+    BOOST_CHECK_THROW( haplo::ResultCache cache(cache_file), std::runtime_error );
+
+    std::ifstream other(cache_file);
+    std::string   line;
+    BOOST_CHECK( std::getline(other, line) && line == "0 1 01" );
+    std::remove(cache_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
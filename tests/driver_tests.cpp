@@ -0,0 +1,280 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   driver_tests.cpp
+/// @brief  Test suite for parahaplo driver tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE DriverTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/driver.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+static constexpr const char* input_four = "input_files/input_four.txt";
+static constexpr const char* input_six  = "input_files/input_six.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+static constexpr const char* input_nine  = "input_files/input_nine.txt";
+static constexpr const char* checkpoint = "driver_test_checkpoint.bin";
+
+using block_type      = haplo::Block<6000, 2, 2>;
+using subblock_type   = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using dispatcher_type = haplo::Dispatcher<subblock_type>;
+using driver_type     = haplo::Driver<block_type, subblock_type>;
+using writer_type     = haplo::RegionWriter<block_type>;
+
+BOOST_AUTO_TEST_SUITE( DriverSuite )
+
+BOOST_AUTO_TEST_CASE( driverMatchesSolvingInOrder )
+{
+    for (const auto input : { input_four, input_six }) {
+        block_type      ordered(input), pipelined(input);
+        dispatcher_type dispatcher;
+        driver_type     driver;
+
+        for (size_t i = 0; i < ordered.num_subblocks() - 1; ++i) {
+            if (ordered.solve_trivial(i)) continue;
+            subblock_type sub_block(ordered, i);
+            dispatcher.solve(sub_block);
+            ordered.merge_haplotype(sub_block);
+        }
+        driver.run(pipelined);
+
+        BOOST_CHECK( driver.dispatcher().log().size() == dispatcher.log().size() );
+        for (size_t col_idx = 0; col_idx < ordered.haplo_one().size(); ++col_idx) {
+            BOOST_CHECK( pipelined.haplo_one().get(col_idx) == ordered.haplo_one().get(col_idx) );
+            BOOST_CHECK( pipelined.haplo_two().get(col_idx) == ordered.haplo_two().get(col_idx) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( blockMecIsTheSumOfTheSubBlockMecs )
+{
+    // The first columns of two geraci inputs end to end, whose solutions leave NIH columns free
+    for (const auto input : { input_four, input_six, input_nine }) {
+        block_type  block(input);
+        driver_type driver;
+        driver.run(block);
+
+        // The MEC of the solved subblocks, and of the trivial ones over the reads inside each subblock
+        size_t sum = 0, shared = 0;
+        for (const auto& record : driver.dispatcher().log()) sum += record.mec_score;
+        for (size_t i = 0; i < block.num_subblocks() - 1; ++i) {
+            haplo::StagedSolution  staged;
+            haplo::BinaryVector<2> haplo_one, haplo_two;
+            if (!block.trivial_solution(i, staged)) continue;
+            block.aligned_region(i, staged, 0, haplo_one, haplo_two);
+
+            const size_t start_col = block.subblock(i), end_col = block.subblock(i + 1);
+            for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) {
+                const auto& info = block.read_info(row_idx);
+                if (info.start_index() < start_col || info.end_index() > end_col) continue;
+                size_t contrib_one = 0, contrib_two = 0;
+                for (size_t col_idx = info.start_index(); col_idx <= info.end_index(); ++col_idx) {
+                    const uint8_t value = block(row_idx, col_idx);
+                    if (value <= 1 && value != haplo_one.get(col_idx - start_col)) ++contrib_one;
+                    if (value <= 1 && value != haplo_two.get(col_idx - start_col)) ++contrib_two;
+                }
+                sum += std::min(contrib_one, contrib_two);
+            }
+        }
+
+        // Neighbouring subblocks share a column, so the reads with a value there can differ by one
+        for (size_t i = 1; i < block.num_subblocks() - 1; ++i) {
+            for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx)
+                if (block(row_idx, block.subblock(i)) <= 1) ++shared;
+        }
+        BOOST_CHECK( block.mec_score() <= sum + shared );
+        BOOST_CHECK( block.mec_score() + shared >= sum );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( componentsOfASubBlockAreSolvedSeparately )
+{
+    block_type  split(input_seven), whole(input_seven);
+    driver_type split_driver, whole_driver;
+    whole_driver.set_split_components(false);
+    split_driver.run(split);
+    whole_driver.run(whole);
+
+    // Each component is solved on its own, and the components together are as good as the whole
+    BOOST_CHECK( split_driver.dispatcher().log().size() == 2 );
+    BOOST_CHECK( whole_driver.dispatcher().log().size() == 1 );
+    BOOST_CHECK( split.mec_score() == 2 );
+    BOOST_CHECK( split.mec_score() <= whole.mec_score() );
+    BOOST_CHECK( split_driver.peak_sub_blocks() == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( driverBoundsTheSubBlocksInFlight )
+{
+    block_type  block(input_six);
+    driver_type driver(haplo::CostModel(), 4, 2, 1);
+    driver.run(block);
+
+    BOOST_CHECK( driver.max_in_flight()   == 1 );
+    BOOST_CHECK( driver.peak_sub_blocks() == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( streamedRegionsMatchTheMergedHaplotypes )
+{
+    for (const auto input : { input_four, input_six }) {
+        block_type         merged(input), streamed(input);
+        std::ostringstream output;
+        driver_type        driver;
+        writer_type        writer(streamed, output);
+        driver.run(merged);
+        driver.run(streamed, writer);
+        BOOST_CHECK( writer.complete() );
+
+        // Each line is the start column of a region and its haplotypes
+        std::istringstream lines(output.str());
+        size_t start_col, col_idx = streamed.subblock(0);
+        std::string haplo_one, haplo_two;
+        while (lines >> start_col >> haplo_one >> haplo_two) {
+            BOOST_CHECK( start_col == col_idx );
+            BOOST_CHECK( haplo_one.size() == haplo_two.size() );
+            for (size_t i = 0; i < haplo_one.size(); ++i, ++col_idx) {
+                BOOST_CHECK( haplo_one[i] - '0' == merged.haplo_one().get(col_idx) );
+                BOOST_CHECK( haplo_two[i] - '0' == merged.haplo_two().get(col_idx) );
+            }
+        }
+        BOOST_CHECK( col_idx == streamed.subblock(streamed.num_subblocks() - 1) + 1 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( regionsAreWrittenInOrder )
+{
+    block_type         block(input_four);
+    std::ostringstream output;
+    writer_type        writer(block, output);
+
+    // Solve the non trivial regions, and give them to the writer in reverse
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < block.num_subblocks() - 1; ++i)
+        if (!block.is_trivial(i)) pending.push_back(i);
+    BOOST_REQUIRE( pending.size() > 0 );
+    BOOST_CHECK( writer.written() == pending.front() );
+
+    for (auto i = pending.rbegin(); i != pending.rend(); ++i) {
+        subblock_type sub_block(block, *i);
+        dispatcher_type().solve(sub_block);
+        writer.push(*i, block.staged_solution(sub_block.haplo_one(), sub_block.haplo_two()));
+        if (*i != pending.front()) {
+            BOOST_CHECK( writer.written() == pending.front() );
+            BOOST_CHECK( output.str().empty() );
+        }
+    }
+    BOOST_CHECK( writer.complete() );
+    BOOST_CHECK( writer.pending() == 0 );
+    BOOST_CHECK( !output.str().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( schedulerRunsLargestSubBlocksFirst )
+{
+    for (const auto input : { input_four, input_six }) {
+        block_type       block(input);
+        haplo::Scheduler scheduler(block, haplo::schedule::largest_first, 0.0);
+
+        // Without batching each task is one sub-block, and each non trivial sub-block has one task
+        std::vector<size_t> scheduled;
+        for (size_t t = 0; t < scheduler.tasks().size(); ++t) {
+            BOOST_CHECK( scheduler.tasks()[t].size() == 1 );
+            if (t > 0) BOOST_CHECK( scheduler.cost(t) <= scheduler.cost(t - 1) );
+            scheduled.push_back(scheduler.tasks()[t].front());
+        }
+        std::sort(scheduled.begin(), scheduled.end());
+        for (size_t i = 0, s = 0; i < block.num_subblocks() - 1; ++i) {
+            if (block.is_trivial(i)) continue;
+            BOOST_REQUIRE( s < scheduled.size() );
+            BOOST_CHECK( scheduled[s++] == i );
+        }
+
+        // With batching every sub-block is still scheduled once
+        haplo::Scheduler batched(block, haplo::schedule::largest_first, 1e12, 4);
+        size_t batched_subblocks = 0;
+        for (const auto& task : batched.tasks()) {
+            BOOST_CHECK( task.size() <= 4 );
+            batched_subblocks += task.size();
+        }
+        BOOST_CHECK( batched_subblocks == scheduled.size() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( driverReportsTheMakespan )
+{
+    block_type  block(input_six);
+    driver_type driver(haplo::CostModel(), 2);
+    driver.run(block);
+
+    const auto& report = driver.report();
+    BOOST_CHECK( report.workers == 2 );
+    BOOST_CHECK( report.tasks   == haplo::Scheduler(block).tasks().size() );
+    BOOST_CHECK( report.longest_ns <= report.work_ns );
+    BOOST_CHECK( report.ideal_ns() <= report.makespan_ns );
+    BOOST_CHECK( report.efficiency() > 0.0 && report.efficiency() <= 1.0 );
+}
+
+BOOST_AUTO_TEST_CASE( stoppedRunResumesFromTheCheckpoint )
+{
+    block_type  complete(input_six), restarted(input_six), resumed(input_six), other(input_four);
+    driver_type first, second, third, fourth;
+    std::remove(checkpoint);
+    {
+        haplo::Checkpoint saved(checkpoint, 0.0);
+        first.set_checkpoint(&saved);
+        first.run(complete);
+        BOOST_CHECK( first.resumed() == 0 && saved.written() == first.dispatcher().log().size() );
+    }
+    const size_t solved = first.dispatcher().log().size();
+    BOOST_REQUIRE( solved > 0 );
+
+    // Stopped part way through writing the last record, which is solved again
+    {
+        std::ifstream file(checkpoint, std::ios::binary | std::ios::ate);
+        BOOST_REQUIRE( truncate(checkpoint, static_cast<off_t>(file.tellg()) - 8) == 0 );
+        haplo::Checkpoint saved(checkpoint, 0.0);
+        second.set_checkpoint(&saved);
+        second.run(restarted);
+        BOOST_CHECK( second.resumed()                 == solved - 1 );
+        BOOST_CHECK( second.dispatcher().log().size() == 1          );
+    }
+
+    // Nothing is left to solve after the restarted run
+    haplo::Checkpoint saved(checkpoint, 0.0);
+    third.set_checkpoint(&saved);
+    third.run(resumed);
+    BOOST_CHECK( third.resumed()                 == solved );
+    BOOST_CHECK( third.dispatcher().log().size() == 0      );
+    for (size_t col_idx = 0; col_idx < complete.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( resumed.haplo_one().get(col_idx) == complete.haplo_one().get(col_idx) );
+        BOOST_CHECK( resumed.haplo_two().get(col_idx) == complete.haplo_two().get(col_idx) );
+    }
+
+    // A checkpoint of different input is discarded
+    haplo::Checkpoint mismatched(checkpoint, 0.0);
+    fourth.set_checkpoint(&mismatched);
+    fourth.run(other);
+    BOOST_CHECK( fourth.resumed() == 0 );
+
+    // A file which isn't a checkpoint is left alone
+    {
+        std::ofstream input(checkpoint);
+        input << "0 1 01\n";
+    }
+    haplo::Checkpoint not_checkpoint(checkpoint, 0.0);
+    BOOST_CHECK_THROW( not_checkpoint.open(other), std::runtime_error );
+
+    std::ifstream input(checkpoint);
+    std::string   line;
+    BOOST_CHECK( std::getline(input, line) && line == "0 1 01" );
+    std::remove(checkpoint);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
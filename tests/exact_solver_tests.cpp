@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   exact_solver_tests.cpp
+/// @brief  Test suite for parahaplo exact solver tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE ExactSolverTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/exact_solver.hpp"
+#include "../haplo/graph_cpu.hpp"
+
+static constexpr const char* input_three = "input_files/input_three.txt";
+static constexpr const char* input_five  = "input_files/input_five.txt";
+static constexpr const char* input_six   = "input_files/input_six.txt";
+
+using block_type    = haplo::Block<6000, 2, 2>;
+using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using solver_type   = haplo::ExactSolver<subblock_type>;
+using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+// Determines the lowest MEC score of any bipartition of the reads
+size_t brute_force_mec_score(subblock_type& sub_block)
+{
+    auto  data_cpu  = sub_block.data().to_binary_vector();
+    auto  snp_info  = sub_block.snp_info();
+    auto& read_info = sub_block.read_info();
+
+    haplo::Data data(snp_info.size(), read_info.size());
+    data.data = &data_cpu[0]; data.read_info = &read_info[0]; data.snp_info = &snp_info[0];
+
+    size_t best_mec_score = std::numeric_limits<size_t>::max();
+    for (size_t mask = 0; mask < (size_t(1) << sub_block.reads()); ++mask) {
+        haplo::Partition partition(data);
+        for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+            partition.assign(frag_idx, ((mask >> frag_idx) & 1) + 1);
+        best_mec_score = std::min(best_mec_score, partition.mec_score());
+    }
+    return best_mec_score;
+}
+
+BOOST_AUTO_TEST_SUITE( ExactSolverSuite )
+
+BOOST_AUTO_TEST_CASE( exactSolverMatchesBruteForce )
+{
+    block_type    block(input_three);
+    subblock_type sub_block(block, 1);
+    solver_type   solver(sub_block);
+
+    BOOST_CHECK( solver.search() );
+    BOOST_CHECK( solver.mec_score() == brute_force_mec_score(sub_block) );
+    BOOST_CHECK( solver.mec_score() == solver.partition().mec_score()   );
+}
+
+BOOST_AUTO_TEST_CASE( exactSolverIsNoWorseThanGraphSearch )
+{
+    block_type    block(input_five);
+    subblock_type sub_block(block, 1);
+    graph_type    graph(sub_block);
+    solver_type   solver(sub_block);
+
+    graph.search();
+    BOOST_CHECK( solver.coverage() <= EXACT_MAX_COVERAGE );
+    BOOST_CHECK( solver.search() );
+
+    // The partition of the solution must have the optimal score
+    BOOST_CHECK( solver.mec_score() == solver.partition().mec_score() );
+    BOOST_CHECK( solver.mec_score() <= graph.mec_score()              );
+
+    for (size_t snp_idx = 0; snp_idx < sub_block.snp_info().size(); ++snp_idx) {
+        BOOST_CHECK( sub_block.haplo_one().get(snp_idx) == solver.partition().haplo_one()[snp_idx] );
+        BOOST_CHECK( sub_block.haplo_two().get(snp_idx) == solver.partition().haplo_two()[snp_idx] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( exactSolverRejectsHighCoverage )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    solver_type   solver(sub_block);
+
+    BOOST_CHECK( !solver.solvable() );
+    BOOST_CHECK( !solver.search()   );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,353 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   graph_cpu_tests.cpp
+/// @brief  Test suite for parahaplo CPU graph search tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE GraphCpuTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/graph_cpu.hpp"
+
+static constexpr const char* input_three = "input_files/input_three.txt";
+static constexpr const char* input_four  = "input_files/input_four.txt";
+static constexpr const char* input_six   = "input_files/input_six.txt";
+
+using block_type    = haplo::Block<6000, 2, 2>;
+using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+// Determines the MEC score of a partition from scratch
+size_t partition_mec_score(subblock_type& sub_block, const haplo::Partition& partition)
+{
+    size_t mec_score = 0;
+    for (size_t row_idx = 0; row_idx < sub_block.reads(); ++row_idx) {
+        const auto& haplotype = partition.set(row_idx) == 1 ? partition.haplo_one() : partition.haplo_two();
+        for (size_t col_idx = 0; col_idx < haplotype.size(); ++col_idx) {
+            if (sub_block(row_idx, col_idx) <= 1 && sub_block(row_idx, col_idx) != haplotype[col_idx])
+                ++mec_score;
+        }
+    }
+    return mec_score;
+}
+
+// Determines the MEC score of the haplotypes of a sub-block
+size_t sub_block_mec_score(subblock_type& sub_block)
+{
+    size_t mec_score = 0;
+    for (size_t row_idx = 0; row_idx < sub_block.reads(); ++row_idx) {
+        size_t contrib_one = 0, contrib_two = 0;
+        for (size_t col_idx = 0; col_idx < sub_block.haplo_one().size(); ++col_idx) {
+            const auto value = sub_block(row_idx, col_idx);
+            if (value <= 1 && value != sub_block.haplo_one().get(col_idx)) ++contrib_one;
+            if (value <= 1 && value != sub_block.haplo_two().get(col_idx)) ++contrib_two;
+        }
+        mec_score += std::min(contrib_one, contrib_two);
+    }
+    return mec_score;
+}
+
+BOOST_AUTO_TEST_SUITE( GraphCpuSuite )
+
+BOOST_AUTO_TEST_CASE( gainBucketsPopLargestGainFirst )
+{
+    haplo::GainBuckets buckets(5, 4);
+
+    buckets.insert(0, -2); buckets.insert(1, 3); buckets.insert(2, 0);
+    buckets.insert(3, 3) ; buckets.insert(4, -4);
+    buckets.update(1, -1);
+    buckets.remove(2);
+
+    BOOST_CHECK( buckets.size() == 4 );
+    BOOST_CHECK( buckets.pop()  == 3 );
+    BOOST_CHECK( buckets.pop()  == 1 );
+    BOOST_CHECK( buckets.pop()  == 0 );
+    BOOST_CHECK( buckets.pop()  == 4 );
+    BOOST_CHECK( buckets.empty() );
+    BOOST_CHECK( buckets.pop()  == haplo::GainBuckets::none );
+}
+
+BOOST_AUTO_TEST_CASE( partitionMaintainsMecScoreIncrementally )
+{
+    block_type    block(input_four);
+    subblock_type sub_block(block, 1);
+
+    auto data_cpu  = sub_block.data().to_binary_vector();
+    auto snp_info  = sub_block.snp_info();
+    auto& read_info = sub_block.read_info();
+
+    haplo::Data data(snp_info.size(), read_info.size());
+    data.data = &data_cpu[0]; data.read_info = &read_info[0]; data.snp_info = &snp_info[0];
+
+    haplo::Partition partition(data);
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        partition.assign(frag_idx, frag_idx % 3 == 0 ? 2 : 1);
+
+    BOOST_CHECK( partition.mec_score() == partition_mec_score(sub_block, partition) );
+
+    // Each move must change the score by exactly the predicted delta
+    for (size_t it = 0; it < 200; ++it) {
+        const size_t frag_idx  = (it * 37) % sub_block.reads();
+        const auto   delta     = partition.move_delta(frag_idx);
+        const size_t mec_score = partition.mec_score();
+
+        partition.move(frag_idx);
+
+        BOOST_CHECK( static_cast<int64_t>(partition.mec_score()) - static_cast<int64_t>(mec_score) == delta );
+        BOOST_CHECK( partition.mec_score() == partition_mec_score(sub_block, partition) );
+    }
+
+    size_t mismatches = 0;
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        mismatches += partition.mismatches(frag_idx);
+    BOOST_CHECK( mismatches == partition.mec_score() );
+}
+
+BOOST_AUTO_TEST_CASE( canSearchGraphAndSetSubBlockHaplotypes )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    graph(sub_block);
+
+    graph.search();
+
+    BOOST_CHECK( graph.edges() > 0 );
+    BOOST_CHECK( graph.mec_score() == partition_mec_score(sub_block, graph.partition()) );
+
+    // No single move can improve the refined solution
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        BOOST_CHECK( graph.partition().move_delta(frag_idx) >= 0 );
+
+    // Assigning each read to its closest haplotype can only improve on the partition
+    BOOST_CHECK( sub_block_mec_score(sub_block) <= graph.mec_score() );
+}
+
+BOOST_AUTO_TEST_CASE( batchedMovesMatchSequentialMoves )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+
+    auto data_cpu  = sub_block.data().to_binary_vector();
+    auto snp_info  = sub_block.snp_info();
+    auto& read_info = sub_block.read_info();
+
+    haplo::Data data(snp_info.size(), read_info.size());
+    data.data = &data_cpu[0]; data.read_info = &read_info[0]; data.snp_info = &snp_info[0];
+
+    haplo::Partition batched(data), sequential(data);
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx) {
+        batched.assign(frag_idx, frag_idx % 3 == 0 ? 2 : 1);
+        sequential.assign(frag_idx, frag_idx % 3 == 0 ? 2 : 1);
+    }
+
+    // Select fragments with disjoint spans
+    std::vector<size_t> frags;
+    size_t              next_free = 0;
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx) {
+        if (read_info[frag_idx].start_index() < next_free) continue;
+        frags.push_back(frag_idx);
+        next_free = read_info[frag_idx].end_index() + 1;
+    }
+
+    for (const auto frag_idx : frags) sequential.move(frag_idx);
+    batched.move_batch(frags);
+
+    BOOST_CHECK( frags.size() > 1 );
+    BOOST_CHECK( batched.mec_score() == sequential.mec_score() );
+    BOOST_CHECK( batched.mec_score() == partition_mec_score(sub_block, batched) );
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx) {
+        BOOST_CHECK( batched.set(frag_idx)        == sequential.set(frag_idx)        );
+        BOOST_CHECK( batched.mismatches(frag_idx) == sequential.mismatches(frag_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSearchGraphWithBatchedRefinement )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    graph(sub_block, haplo::refine::batched);
+
+    graph.search();
+
+    BOOST_CHECK( graph.mec_score() == partition_mec_score(sub_block, graph.partition()) );
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        BOOST_CHECK( graph.partition().move_delta(frag_idx) >= 0 );
+    BOOST_CHECK( sub_block_mec_score(sub_block) <= graph.mec_score() );
+}
+
+BOOST_AUTO_TEST_CASE( multiStartSearchIsReproducibleAndNoWorse )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    single(sub_block);
+    graph_type    multi_one(sub_block, haplo::refine::fm, 4, 7);
+    graph_type    multi_two(sub_block, haplo::refine::fm, 4, 7);
+
+    single.search(); multi_one.search(); multi_two.search();
+
+    // The first start is the single search, so the best of the starts is no worse
+    BOOST_CHECK( multi_one.mec_score() <= single.mec_score() );
+    BOOST_CHECK( multi_one.mec_score() == partition_mec_score(sub_block, multi_one.partition()) );
+
+    BOOST_CHECK( multi_one.mec_score() == multi_two.mec_score() );
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        BOOST_CHECK( multi_one.partition().set(frag_idx) == multi_two.partition().set(frag_idx) );
+}
+
+BOOST_AUTO_TEST_CASE( searchControlStopsTheRefinement )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    converged(sub_block), restarts(sub_block), target(sub_block), deadline(sub_block);
+
+    restarts.control().set_max_stalled_iters(8);
+    target.control().set_target_mec(std::numeric_limits<size_t>::max());
+    deadline.control().set_time_budget(std::chrono::microseconds(1));
+    deadline.control().set_max_stalled_iters(std::numeric_limits<size_t>::max());
+
+    converged.search(); restarts.search(); target.search(); deadline.search();
+
+    BOOST_CHECK( converged.stop_reason() == haplo::stop::converged );
+    BOOST_CHECK( restarts.stop_reason()  == haplo::stop::converged );
+    BOOST_CHECK( target.stop_reason()    == haplo::stop::target    );
+    BOOST_CHECK( deadline.stop_reason()  == haplo::stop::deadline  );
+
+    // Restarts keep the best solution, and early stops still give a valid solution
+    BOOST_CHECK( restarts.mec_score() <= converged.mec_score() );
+    BOOST_CHECK( restarts.mec_score() == partition_mec_score(sub_block, restarts.partition()) );
+    BOOST_CHECK( target.mec_score()   == partition_mec_score(sub_block, target.partition())   );
+    BOOST_CHECK( deadline.mec_score() == partition_mec_score(sub_block, deadline.partition()) );
+}
+
+BOOST_AUTO_TEST_CASE( sparseGraphBoundsTheEdgesPerFragment )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    dense(sub_block), sparse(sub_block);
+
+    sparse.set_max_neighbours(4);
+    dense.search(); sparse.search();
+
+    BOOST_CHECK( sparse.edges() <= 4 * sub_block.reads() );
+    BOOST_CHECK( sparse.edges() <  dense.edges()         );
+
+    // The refinement does not use the edges, so the solution is still a local optimum
+    BOOST_CHECK( sparse.mec_score() == partition_mec_score(sub_block, sparse.partition()) );
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        BOOST_CHECK( sparse.partition().move_delta(frag_idx) >= 0 );
+}
+
+BOOST_AUTO_TEST_CASE( sketchBucketsOfDuplicateReadsAreCapped )
+{
+    // Many copies of a read (and of its complement) all fall in the same buckets
+    const size_t snps = 8, reads = 1000;
+    std::vector<uint8_t>         values(snps * reads);
+    std::vector<haplo::ReadInfo> read_info;
+    for (size_t read_idx = 0; read_idx < reads; ++read_idx) {
+        for (size_t snp_idx = 0; snp_idx < snps; ++snp_idx)
+            values[read_idx * snps + snp_idx] = (snp_idx + read_idx) % 2;
+        read_info.emplace_back(read_idx, 0, snps - 1, read_idx * snps);
+    }
+    haplo::Data data(snps, reads);
+    data.data = values.data(); data.read_info = read_info.data(); data.snp_info = nullptr;
+
+    const haplo::FragmentSketches sketches(data);
+    std::vector<size_t>           candidates, all;
+    for (const size_t frag_idx : { size_t(0), size_t(500), reads - 1 }) {
+        candidates.clear();
+        sketches.candidates(frag_idx, candidates);
+        BOOST_CHECK( candidates.size() <= 2 * sketches.bands * sketches.max_bucket );
+        BOOST_CHECK( std::find(candidates.begin(), candidates.end(), frag_idx) != candidates.end() );
+        all.insert(all.end(), candidates.begin(), candidates.end());
+    }
+    BOOST_CHECK( std::find(all.begin(), all.end(), size_t(1)) != all.end() );
+}
+
+BOOST_AUTO_TEST_CASE( lowerBoundStopsTheSearchAtTheOptimum )
+{
+    block_type    block_three(input_three), block_six(input_six);
+    subblock_type sub_block_three(block_three, 1), sub_block_six(block_six, 1);
+    graph_type    optimal(sub_block_three), bounded(sub_block_six);
+
+    optimal.search(); bounded.search();
+
+    // The optimum of input three (found by brute force) is 2, which the bound proves
+    BOOST_CHECK( optimal.control().lower_bound() == 2                      );
+    BOOST_CHECK( optimal.mec_score()             == 2                      );
+    BOOST_CHECK( optimal.stop_reason()           == haplo::stop::optimal   );
+
+    BOOST_CHECK( bounded.control().lower_bound() >  0                      );
+    BOOST_CHECK( bounded.control().lower_bound() <= bounded.mec_score()    );
+    BOOST_CHECK( bounded.stop_reason()           == haplo::stop::converged );
+}
+
+BOOST_AUTO_TEST_CASE( packedEdgesSortByConfidenceThenFragments )
+{
+    using edge_type = haplo::PackedEdge;
+    BOOST_CHECK( sizeof(edge_type) == 8 );
+
+    const edge_type far(1.5f, 7, 16777215), near(0.9f, 3, 4), tie(1.1f, 2, 9), same(1.1f, 2, 8);
+    BOOST_CHECK( far.f1()  == 7        );
+    BOOST_CHECK( far.f2()  == 16777215 );
+    BOOST_CHECK( far.opposite()        );
+    BOOST_CHECK( !near.opposite()      );
+    BOOST_CHECK_CLOSE( near.distance(), 0.9f, 0.01f );
+    BOOST_CHECK_CLOSE( far.distance() , 1.5f, 0.01f );
+
+    // The most confident edge is first, and edges with equal confidence are ordered by fragment
+    std::vector<edge_type> edges = { near, tie, far, same };
+    std::sort(edges.begin(), edges.end());
+    BOOST_CHECK( edges[0].key() == far.key()  );
+    BOOST_CHECK( edges[1].key() == same.key() );
+    BOOST_CHECK( edges[2].key() == tie.key()  );
+    BOOST_CHECK( edges[3].key() == near.key() );
+
+    BOOST_CHECK( tie.same_fragments(edge_type(0.6f, 2, 9)) );
+    BOOST_CHECK( !tie.same_fragments(same)                 );
+}
+
+BOOST_AUTO_TEST_CASE( edgeStoreMergesSpilledRunsInOrder )
+{
+    using edge_type = haplo::PackedEdge;
+    haplo::EdgeStore store(16 * sizeof(edge_type));
+    std::vector<edge_type> edges;
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> distances(0.5f, 1.5f);
+    for (size_t i = 0; i < 200; ++i) {
+        edges.emplace_back(distances(generator), i, 1000 + i);
+        store.push_back(edges.back());
+        if (i % 10 == 9) store.spill_if_over_budget();
+    }
+    store.sort();
+    std::sort(edges.begin(), edges.end());
+
+    BOOST_CHECK( store.runs() >  1   );
+    BOOST_CHECK( store.size() == 200 );
+
+    size_t i = 0;
+    store.for_each([&](const edge_type& edge) { BOOST_CHECK( edge.key() == edges[i++].key() ); });
+    BOOST_CHECK( i == 200 );
+}
+
+BOOST_AUTO_TEST_CASE( edgeBudgetGivesTheSameSolution )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    graph_type    unbounded(sub_block), bounded(sub_block);
+
+    bounded.set_edge_budget(64);
+    unbounded.search(); bounded.search();
+
+    BOOST_CHECK( unbounded.edge_runs() == 0                     );
+    BOOST_CHECK( bounded.edge_runs()   >  0                     );
+    BOOST_CHECK( bounded.edges()       == unbounded.edges()     );
+    BOOST_CHECK( bounded.mec_score()   == unbounded.mec_score() );
+    for (size_t frag_idx = 0; frag_idx < sub_block.reads(); ++frag_idx)
+        BOOST_CHECK( bounded.partition().set(frag_idx) == unbounded.partition().set(frag_idx) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
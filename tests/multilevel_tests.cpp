@@ -0,0 +1,57 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   multilevel_tests.cpp
+/// @brief  Test suite for parahaplo multilevel solver tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE MultilevelTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/graph_cpu.hpp"
+#include "../haplo/multilevel.hpp"
+
+static constexpr const char* input_four = "input_files/input_four.txt";
+static constexpr const char* input_six  = "input_files/input_six.txt";
+
+using block_type    = haplo::Block<6000, 2, 2>;
+using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using solver_type   = haplo::MultilevelSolver<subblock_type>;
+using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+BOOST_AUTO_TEST_SUITE( MultilevelSuite )
+
+BOOST_AUTO_TEST_CASE( coarseningShrinksEachLevel )
+{
+    block_type    block(input_six);
+    subblock_type sub_block(block, 1);
+    solver_type   solver(sub_block, 32);
+
+    solver.search();
+
+    // Duplicate reads share a node, so even the finest level can have fewer nodes than reads
+    BOOST_CHECK( solver.levels()  >  1                 );
+    BOOST_CHECK( solver.nodes(0)  <= sub_block.reads() );
+    for (size_t level = 1; level < solver.levels(); ++level)
+        BOOST_CHECK( solver.nodes(level) < solver.nodes(level - 1) );
+}
+
+BOOST_AUTO_TEST_CASE( multilevelSolverMatchesGraphSearch )
+{
+    block_type    block_four(input_four), block_six(input_six);
+    subblock_type sub_block_four(block_four, 1), sub_block_six(block_six, 1);
+    solver_type   solver_four(sub_block_four), solver_six(sub_block_six);
+    graph_type    graph_four(sub_block_four), graph_six(sub_block_six);
+
+    solver_four.search(); solver_six.search();
+    BOOST_CHECK( solver_four.mec_score() == solver_four.partition().mec_score() );
+    BOOST_CHECK( solver_six.mec_score()  == solver_six.partition().mec_score()  );
+
+    graph_four.search(); graph_six.search();
+    BOOST_CHECK( solver_four.mec_score() <= graph_four.mec_score() );
+    BOOST_CHECK( solver_six.mec_score()  <= graph_six.mec_score()  );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
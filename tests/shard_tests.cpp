@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   shard_tests.cpp
+/// @brief  Test suite for parahaplo sharding tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE ShardTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/driver.hpp"
+#include "../haplo/shard.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static constexpr const char* input_six  = "input_files/input_six.txt";
+static constexpr const char* input_nine = "input_files/input_nine.txt";
+static constexpr const char* shard_dir = "shard_test_output";
+static constexpr const char* repeated  = "shard_test_input.txt";
+
+using block_type    = haplo::Block<18000, 2, 2>;
+using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+using driver_type   = haplo::Driver<block_type, subblock_type>;
+
+// Writes an input which is an input repeated, with each copy after the columns of the last, so that the
+// input can be cut between the copies
+void write_repeated(const char* input, const size_t copies, const size_t cols)
+{
+    std::ofstream output(repeated);
+    for (size_t copy = 0; copy < copies; ++copy) {
+        std::ifstream file(input);
+        std::string   line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            size_t             start, end;
+            std::string        data;
+            if (fields >> start >> end >> data)
+                output << start + copy * cols << ' ' << end + copy * cols << ' ' << data << '\n';
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE( ShardSuite )
+
+BOOST_AUTO_TEST_CASE( shardsCoverTheInputAndMergeBack )
+{
+    write_repeated(input_six, 3, block_type(input_six).haplo_one().size());
+    block_type     block(repeated);
+    haplo::Sharder sharder(shard_dir);
+    const size_t   shards = sharder.split(block, repeated, 3);
+    BOOST_REQUIRE( shards > 1 );
+
+    // The shards are contiguous, and have all the reads
+    size_t reads = 0, shard_mec = 0;
+    for (const auto& shard : sharder.shards()) {
+        if (shard.index > 0) BOOST_CHECK( shard.start_col <= sharder.shards()[shard.index - 1].end_col + 1 );
+        reads += shard.reads;
+
+        // Phase each shard as a worker would
+        block_type  shard_block(shard.input.c_str());
+        driver_type driver;
+        driver.run(shard_block);
+        BOOST_CHECK( shard_block.haplo_one().size() == shard.end_col - shard.start_col + 1 );
+        shard_mec += shard_block.mec_score();
+
+        std::ofstream result(shard.result);
+        shard_block.write_haplotypes(result);
+    }
+    BOOST_CHECK( reads == block.reads() );
+    BOOST_CHECK( sharder.shards().back().end_col + 1 == block.haplo_one().size() );
+
+    // The merge tool reads the manifest -- aligning the shards doesn't change the MEC score of any read
+    haplo::Sharder         merger(shard_dir);
+    haplo::BinaryVector<2> haplo_one, haplo_two;
+    BOOST_REQUIRE( merger.shards().size() == shards );
+    merger.merge(haplo_one, haplo_two);
+    BOOST_CHECK( haplo_one.size() == block.haplo_one().size() );
+    BOOST_CHECK( block.mec_score(haplo_one, haplo_two) == shard_mec );
+
+    // A missing result is an error
+    std::remove(merger.shards().back().result.c_str());
+    BOOST_CHECK_THROW( merger.merge(haplo_one, haplo_two), std::runtime_error );
+
+    for (const auto& shard : merger.shards()) {
+        std::remove(shard.input.c_str());
+        std::remove(shard.result.c_str());
+    }
+    std::remove(merger.manifest().c_str());
+    std::remove(shard_dir);
+    std::remove(repeated);
+}
+
+BOOST_AUTO_TEST_CASE( splittingIntoAnUncreatableDirectoryThrows )
+{
+    block_type     block(input_six);
+    haplo::Sharder sharder("no_such_directory/shards");
+    BOOST_CHECK_THROW( sharder.split(block, input_six, 2), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( inputsWithEmptyColumnsAreRejected )
+{
+    // Columns 149 and 178 have no values, so the block has fewer columns than the reads span
+    block_type     block(input_nine);
+    haplo::Sharder sharder(shard_dir);
+    BOOST_REQUIRE( block.haplo_one().size() < 298 );
+    BOOST_CHECK_THROW( sharder.split(block, input_nine, 3), std::runtime_error );
+    BOOST_CHECK( sharder.shards().empty() );
+
+    std::ifstream manifest(sharder.manifest());
+    BOOST_CHECK( !manifest );
+}
+
+BOOST_AUTO_TEST_CASE( mergingWithoutAManifestThrows )
+{
+    haplo::Sharder         merger("no_such_directory");
+    haplo::BinaryVector<2> haplo_one, haplo_two;
+    BOOST_CHECK( merger.shards().empty() );
+    BOOST_CHECK_THROW( merger.merge(haplo_one, haplo_two), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,8 @@ static constexpr const char* input_one    = "input_files/input_one.txt";
 static constexpr const char* input_two    = "input_files/input_two.txt";
 static constexpr const char* input_three  = "input_files/input_three.txt";
 static constexpr const char* input_four  = "input_files/input_four.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+static constexpr const char* input_six   = "input_files/input_six.txt";
 
 BOOST_AUTO_TEST_SUITE( SubBlockSuite )
 
@@ -84,4 +86,88 @@ BOOST_AUTO_TEST_CASE( canRemoveMonotoneColumns )
     BOOST_CHECK( sub_block(3, 3)  == 1 );
 }
 
+BOOST_AUTO_TEST_CASE( canCreateSubBlockOfAComponent )
+{
+    using block_type    = haplo::Block<200, 2, 2>;
+    using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+
+    // The reads of the input have values in either the even or the odd columns, so the columns of the
+    // sub-block are two components, although the reads of the components overlap
+    block_type block(input_seven);
+    BOOST_REQUIRE( block.subblock_shape(1).components == 2 );
+    const auto& components = block.column_components(1);
+    BOOST_CHECK( components.size() == 10 );
+    for (size_t snp_idx = 0; snp_idx < components.size(); ++snp_idx)
+        BOOST_CHECK( components[snp_idx] == snp_idx % 2 );
+
+    subblock_type evens(block, 1, 0), odds(block, 1, 1), all(block, 1);
+    BOOST_CHECK( evens.reads() == 8 );
+    BOOST_CHECK( odds.reads()  == 7 );
+    BOOST_CHECK( all.reads()   == 15 );
+    BOOST_CHECK( evens.snp_info().size() == 5 );
+    BOOST_CHECK( all.snp_info().size()   == 10 );
+
+    // The columns of the other component are removed
+    BOOST_CHECK( evens(0, 0) == 1 );
+    BOOST_CHECK( evens(0, 1) == 0 );
+    BOOST_CHECK( evens(0, 4) == 0 );
+    BOOST_CHECK( evens(4, 0) == 3 );
+    BOOST_CHECK( evens(4, 1) == 0 );
+    BOOST_CHECK( evens(4, 3) == 1 );
+    BOOST_CHECK( odds(0, 0)  == 0 );
+    BOOST_CHECK( odds(0, 2)  == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( canCapTheCoverageOfColumns )
+{
+    using block_type    = haplo::Block<6000, 2, 2>;
+    using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+
+    block_type    block(input_six);
+    subblock_type all(block, 1);
+    block.set_max_coverage(5);
+    subblock_type capped(block, 1);
+
+    // The reads which are dropped are kept aside, and all of the columns are kept
+    BOOST_CHECK( all.dropped_reads().empty() );
+    BOOST_CHECK( capped.reads() < all.reads() );
+    BOOST_CHECK( capped.reads() + capped.dropped_reads().size() == all.reads() );
+    BOOST_CHECK( capped.snp_info().size() == all.snp_info().size() );
+
+    for (size_t col_idx = 0; col_idx < capped.snp_info().size(); ++col_idx) {
+        size_t coverage = 0;
+        for (size_t row_idx = 0; row_idx < capped.reads(); ++row_idx)
+            coverage += capped(row_idx, col_idx) <= 1;
+        BOOST_CHECK( coverage >= 1 && coverage <= 5 );
+    }
+
+    // The cost estimate of the sub-block follows the cap
+    BOOST_CHECK( block.subblock_shape(1).reads < all.reads() );
+}
+
+BOOST_AUTO_TEST_CASE( readsAreTakenBackToKeepEveryColumn )
+{
+    using block_type    = haplo::Block<6000, 2, 2>;
+    using subblock_type = haplo::SubBlock<block_type, 2, 2, haplo::devices::cpu>;
+
+    block_type    block(input_six);
+    subblock_type all(block, 1);
+    block.set_max_coverage(1);
+    subblock_type capped(block, 1);
+
+    // A cap of one leaves most columns without a read, so reads are taken back to cover them, which takes
+    // some columns over the cap -- but every column is still kept
+    size_t over_cap = 0;
+    for (size_t col_idx = 0; col_idx < capped.snp_info().size(); ++col_idx) {
+        size_t coverage = 0;
+        for (size_t row_idx = 0; row_idx < capped.reads(); ++row_idx)
+            coverage += capped(row_idx, col_idx) <= 1;
+        BOOST_CHECK( coverage >= 1 );
+        over_cap += coverage > 1;
+    }
+    BOOST_CHECK( over_cap > 0 );
+    BOOST_CHECK( capped.snp_info().size() == all.snp_info().size() );
+    BOOST_CHECK( capped.reads() + capped.dropped_reads().size() == all.reads() );
+}
+
 BOOST_AUTO_TEST_SUITE_END()